@@ -0,0 +1,95 @@
+#ifndef __ALIAS_HPP__
+#define __ALIAS_HPP__
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// Walker's alias method for sampling from a discrete distribution in O(1),
+// after an O(n) construction. rebuilding reuses the table's storage, so a
+// table of unchanging size never allocates after its first build.
+class AliasTable {
+
+    public:
+
+        // rebuild the table from a vector of non-negative weights,
+        // which need not be normalised
+        void build(const std::vector<double> &weights) {
+            size_t n = weights.size();
+            assert(n > 0);
+
+            double total = 0.0;
+            for (size_t i = 0; i < n; i++) {
+                total += weights[i];
+            }
+            assert(total > 0.0);
+
+            m_prob.resize(n);
+            m_alias.resize(n);
+            m_small.clear();
+            m_large.clear();
+
+            // scale each weight so that the average bucket is 1
+            for (size_t i = 0; i < n; i++) {
+                m_prob[i] = weights[i] * static_cast<double>(n) / total;
+                m_alias[i] = i;
+                if (m_prob[i] < 1.0) {
+                    m_small.push_back(i);
+                } else {
+                    m_large.push_back(i);
+                }
+            }
+
+            // fill each under-full bucket with mass from an over-full one
+            while (!m_small.empty() && !m_large.empty()) {
+                size_t s = m_small.back(); m_small.pop_back();
+                size_t l = m_large.back();
+
+                m_alias[s] = l;
+                m_prob[l] -= 1.0 - m_prob[s];
+
+                if (m_prob[l] < 1.0) {
+                    m_large.pop_back();
+                    m_small.push_back(l);
+                }
+            }
+
+            // whatever remains is full, up to rounding error
+            for (size_t i : m_small) m_prob[i] = 1.0;
+            for (size_t i : m_large) m_prob[i] = 1.0;
+        }
+
+        // draw an index with probability proportional to its weight, using
+        // a generator such as RandomEngine with a uniform() in [0, 1)
+        template <class Generator>
+        size_t sample(Generator &generator) const {
+            assert(!m_prob.empty());
+
+            double n = static_cast<double>(m_prob.size());
+
+            double x = generator.uniform() * n;
+            size_t i = static_cast<size_t>(x);
+            if (i >= m_prob.size()) i = m_prob.size() - 1;
+
+            return (x - static_cast<double>(i)) < m_prob[i] ? i : m_alias[i];
+        }
+
+    private:
+
+        std::vector<double> m_prob;
+        std::vector<size_t> m_alias;
+
+        // construction worklists, kept to avoid reallocation
+        std::vector<size_t> m_small;
+        std::vector<size_t> m_large;
+};
+
+
+/* -------------------------------------------------------------------------- */
+
+
+#endif // __ALIAS_HPP__
@@ -34,25 +34,65 @@
 GeometricAbruptChangeSchedule::GeometricAbruptChangeSchedule(
     double p,
     size_t max_trials,
-    unsigned int seed
+    const rng_seed_t &seed
 ) :
-    m_generator(seed)
+    m_p(p),
+    m_max_trials(max_trials),
+    m_seed(seed)
 {
-    std::geometric_distribution<size_t> gdist(p);
+    rewind();
+}
+
+
+/* the change points are the partial sums of geometric gaps, starting from
+   0, which fall before max_trials. consecutive sums may coincide. */
+void GeometricAbruptChangeSchedule::rewind() const {
+    m_generator.seed(m_seed);
+    m_prev = NoChangepoint;
+
+    // the rate is 0 for a stationary problem, which has no change points
+    if (m_p <= 0.0 || m_max_trials == 0) {
+        m_cursor = NoChangepoint;
+        return;
+    }
+
+    m_gaps = std::geometric_distribution<size_t>(m_p);
+    m_cursor = 0;
+    advance();
+    m_prev = NoChangepoint;
+}
+
 
-    size_t upto = 0;
-    do {
-        size_t inc = gdist(m_generator);
-        upto += inc;
+void GeometricAbruptChangeSchedule::advance() const {
+    m_prev = m_cursor;
 
-        if (upto < max_trials)
-            m_cpts.insert(upto);
-    } while (upto < max_trials);
+    size_t gap = m_gaps(m_generator);
+    if (gap >= m_max_trials - m_cursor) {
+        m_cursor = NoChangepoint;
+    } else {
+        m_cursor += gap;
+    }
 }
 
 
 bool GeometricAbruptChangeSchedule::changepoint(size_t t) const {
-    return m_cpts.find(t) != m_cpts.cend();
+    if (m_prev != NoChangepoint && t <= m_prev) {
+        if (t == m_prev) return true;
+        rewind();
+    }
+
+    while (m_cursor < t) advance();
+
+    return m_cursor == t;
+}
+
+
+size_t GeometricAbruptChangeSchedule::nextChangepoint(size_t t) const {
+    if (m_prev != NoChangepoint && t < m_prev) rewind();
+
+    while (m_cursor <= t && m_cursor != NoChangepoint) advance();
+
+    return m_cursor;
 }
 
 
@@ -62,12 +102,21 @@ bool GeometricAbruptChangeSchedule::changepoint(size_t t) const {
 VectorAbruptChangeSchedule::VectorAbruptChangeSchedule(
     const std::vector<size_t> &times
 ) :
-    m_cpts(times.begin(), times.end())
-{}
+    m_cpts(times)
+{
+    std::sort(m_cpts.begin(), m_cpts.end());
+    m_cpts.erase(std::unique(m_cpts.begin(), m_cpts.end()), m_cpts.end());
+}
 
 
 bool VectorAbruptChangeSchedule::changepoint(size_t t) const {
-    return m_cpts.find(t) != m_cpts.cend();
+    return std::binary_search(m_cpts.begin(), m_cpts.end(), t);
+}
+
+
+size_t VectorAbruptChangeSchedule::nextChangepoint(size_t t) const {
+    auto next = std::upper_bound(m_cpts.begin(), m_cpts.end(), t);
+    return next == m_cpts.end() ? NoChangepoint : *next;
 }
 
 
@@ -90,6 +139,14 @@ bool TwoPhaseChangeSchedule::changepoint(size_t t) const {
 }
 
 
+size_t TwoPhaseChangeSchedule::nextChangepoint(size_t t) const {
+    if (t < 1) return 1;
+    if (t < m_halfway) return m_halfway;
+
+    return NoChangepoint;
+}
+
+
 arm_initialisation_t TwoPhaseChangeSchedule::customArmInitialisation(
   size_t t
 ) const {
@@ -106,7 +163,7 @@ arm_initialisation_t TwoPhaseChangeSchedule::customArmInitialisation(
 
 StochasticBanditProblem::StochasticBanditProblem(
     size_t n_arms,
-    unsigned int seed,
+    const rng_seed_t &seed,
     std::unique_ptr<ChangeSchedule> cs
 ) :
     m_generator(seed),
@@ -114,6 +171,7 @@ StochasticBanditProblem::StochasticBanditProblem(
     m_thetas(n_arms, 0.0)
 {
     reset();
+    m_next_changepoint = m_change_schedule->nextChangepoint(0);
 }
 
 
@@ -124,45 +182,74 @@ double StochasticBanditProblem::pull(size_t arm_index) {
 
   m_num_trials++;
 
-  std::bernoulli_distribution coin(m_thetas[arm_index]);
-  bool flip = coin(m_generator);
+  bool flip = m_generator.uniform() < m_thetas[arm_index];
   double r = flip ? 1.0 : 0.0;
 
   m_cumm_reward += r;
+  m_exp_cumm_reward += m_best_theta;
 
-  auto ba = bestArm();
-  m_exp_cumm_reward += m_thetas[ba];
+  if (m_num_trials == m_next_changepoint) change();
 
-  if (m_change_schedule->changepoint(m_num_trials)) {
-    auto new_thetas = m_change_schedule->customArmInitialisation(m_num_trials);
-    if (new_thetas.empty()) {
-      // default to generate thetas uniformly at random
-      reset();
-    } else {
-      assert(new_thetas.size() == m_thetas.size());
-      m_thetas = new_thetas;
+  return r;
+}
+
+
+/* the thetas are fixed between change points, so each run of pulls up to
+   the next change is a tight loop over the arms. the totals are summed in
+   the same order as by pull, so the results are bit-identical. */
+void StochasticBanditProblem::pullMany(pull_t *pulls, size_t n) {
+  size_t i = 0;
+
+  while (i < n) {
+    size_t run = std::min(n - i, m_next_changepoint - m_num_trials);
+    const double *thetas = m_thetas.data();
+
+    for (size_t end = i + run; i < end; i++) {
+      if (pulls[i].arm >= m_thetas.size()) {
+        die_with_error("invalid arm index");
+      }
+
+      pulls[i].reward = m_generator.uniform() < thetas[pulls[i].arm] ? 1 : 0;
+      m_cumm_reward += pulls[i].reward;
+      m_exp_cumm_reward += m_best_theta;
     }
+
+    m_num_trials += run;
+    if (m_num_trials == m_next_changepoint) change();
   }
+}
 
-  return r;
+
+void StochasticBanditProblem::change() {
+  m_next_changepoint = m_change_schedule->nextChangepoint(m_num_trials);
+
+  auto new_thetas = m_change_schedule->customArmInitialisation(m_num_trials);
+  if (new_thetas.empty()) {
+    // default to generate thetas uniformly at random
+    reset();
+  } else {
+    assert(new_thetas.size() == m_thetas.size());
+    m_thetas = new_thetas;
+    refreshBest();
+  }
 }
 
 
 void StochasticBanditProblem::reset() {
-    std::uniform_real_distribution<double> unit_interval_dist(0.0, 1.0);
-
     for (size_t i = 0; i < m_thetas.size(); i++) {
-        double r = unit_interval_dist(m_generator);
+        double r = m_generator.uniform();
         m_thetas[i] = r;
     }
+
+    refreshBest();
 }
 
 
-size_t StochasticBanditProblem::bestArm() const {
-    return std::distance(
-        m_thetas.begin(),
-        std::max_element(m_thetas.begin(), m_thetas.end())
-    );
+void StochasticBanditProblem::refreshBest() {
+    auto best = std::max_element(m_thetas.begin(), m_thetas.end());
+
+    m_best_arm = std::distance(m_thetas.begin(), best);
+    m_best_theta = m_thetas.empty() ? 0.0 : *best;
 }
 
 
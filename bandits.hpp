@@ -2,18 +2,37 @@
 #define __BANDITS_HPP__
 
 #include <cstddef>
+#include <cstdint>
 #include <limits>
 #include <memory>
 #include <ostream>
 #include <random>
-#include <set>
 #include <string>
 #include <vector>
 
+#include "rng.hpp"
+
+class SnapshotReader;
+class SnapshotWriter;
+
 
 /* -------------------------------------------------------------------------- */
 
 
+// an arm that was pulled, together with the reward it received
+struct pull_t {
+    size_t arm;
+    int reward;
+};
+
+
+// a view of the PTW model underlying a strategy, used when profiling
+struct ptw_profile_t {
+    size_t depth;                                // the current model depth
+    uint64_t updates;                            // the updates processed
+};
+
+
 // an interface describing a bandit strategy
 class BanditStrategy {
 
@@ -26,9 +45,41 @@ class BanditStrategy {
         // pulling an arm and reeiving a reward
         virtual void update(size_t arm, int reward) = 0;
 
+        // get n actions at once, before the reward of any is known, as when
+        // feedback is delayed; equivalent to n calls of getAction
+        virtual void getActions(size_t n, size_t *out) {
+            for (size_t i = 0; i < n; i++) out[i] = getAction();
+        }
+
+        // update the internal state with n pulls, in order
+        virtual void updateBatch(const pull_t *pulls, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                update(pulls[i].arm, pulls[i].reward);
+            }
+        }
+
         // name of the method, e.g. UCB
         virtual std::string name() const = 0;
 
+        // describe the underlying PTW model, returning false if there is none
+        virtual bool ptwProfile(ptw_profile_t & /* out */) const {
+            return false;
+        }
+
+        // the posterior over the levels of the underlying PTW model, or
+        // nullptr if there is none. a stale posterior is refreshed, so it is
+        // only read once the actions it serves have been chosen
+        virtual const std::vector<double> *ptwLevelPosterior() const {
+            return nullptr;
+        }
+
+        // append the state needed to resume the strategy to a snapshot
+        virtual void save(SnapshotWriter &out) const = 0;
+
+        // resume from a record written by save(), replacing the state of a
+        // strategy constructed with the same name and number of arms
+        virtual void restore(SnapshotReader &in) = 0;
+
         virtual ~BanditStrategy() = default;
 };
 
@@ -56,9 +107,18 @@ class ChangeSchedule {
 
     public:
 
+        // the result of nextChangepoint once no change points remain
+        static constexpr size_t NoChangepoint =
+            std::numeric_limits<size_t>::max();
+
         // does the underlying environment change at this point
         virtual bool changepoint(size_t t) const = 0;
 
+        // the first change point after time t, or NoChangepoint. problems
+        // step through time, so query the schedule at non-decreasing times,
+        // which a schedule may exploit by advancing a cursor
+        virtual size_t nextChangepoint(size_t t) const = 0;
+
         // allows the specification of custom assignments of arm parameters,
         // defaulting to an empty vector which applies no additional change
         // from the default mechanism specified by the bandit problem
@@ -77,10 +137,13 @@ class NoChangeSchecule : public ChangeSchedule {
 
         bool changepoint(size_t) const override { return false; }
 
+        size_t nextChangepoint(size_t) const override { return NoChangepoint; }
 };
 
 
-// generate a sequence of geometrically spaced change-points
+// generate a sequence of geometrically spaced change-points before
+// max_trials. the gaps are drawn lazily, as a cursor over the sequence
+// advances, so the schedule takes O(1) memory for any horizon
 class GeometricAbruptChangeSchedule : public ChangeSchedule {
 
     public:
@@ -88,16 +151,34 @@ class GeometricAbruptChangeSchedule : public ChangeSchedule {
         GeometricAbruptChangeSchedule(
             double p,
             size_t max_trials,
-            unsigned int seed
+            const rng_seed_t &seed
         );
 
-        // checks if a changepoint at t with log(t) time complexity
-        bool changepoint(size_t) const override;
+        // O(1) amortised over non-decreasing times, while an earlier time
+        // than the last change point passed regenerates the sequence
+        bool changepoint(size_t t) const override;
+
+        size_t nextChangepoint(size_t t) const override;
 
     private:
 
-        mutable std::default_random_engine m_generator;
-        std::set<size_t> m_cpts;
+        // restart the cursor at the beginning of the sequence
+        void rewind() const;
+
+        // move the cursor to the next change point
+        void advance() const;
+
+        double m_p;
+        size_t m_max_trials;
+        rng_seed_t m_seed;
+
+        mutable RandomEngine m_generator;
+        mutable std::geometric_distribution<size_t> m_gaps;
+
+        // the last change point passed, or NoChangepoint if none has
+        // been, and the next change point
+        mutable size_t m_prev;
+        mutable size_t m_cursor;
 };
 
 
@@ -111,9 +192,12 @@ class VectorAbruptChangeSchedule : public ChangeSchedule {
         // checks if a changepoint at t with log(t) time complexity
         bool changepoint(size_t t) const override;
 
+        size_t nextChangepoint(size_t t) const override;
+
     private:
 
-        std::set<size_t> m_cpts;
+        // the distinct change points, in increasing order
+        std::vector<size_t> m_cpts;
 };
 
 
@@ -134,6 +218,8 @@ class TwoPhaseChangeSchedule : public ChangeSchedule {
 
         bool changepoint(size_t t) const override;
 
+        size_t nextChangepoint(size_t t) const override;
+
         arm_initialisation_t customArmInitialisation(size_t t) const override;
 
     private:
@@ -162,7 +248,7 @@ class StochasticBanditProblem {
         // ChangeSchedule
         StochasticBanditProblem(
             size_t n_arms,
-            unsigned int seed,
+            const rng_seed_t &seed,
             std::unique_ptr<ChangeSchedule> cs =
                 std::make_unique<NoChangeSchecule>()
         );
@@ -170,6 +256,10 @@ class StochasticBanditProblem {
         // pull an arm, receive reward
         double pull(size_t arm_index);
 
+        // pull each of n arms in order, as by n calls of pull, writing the
+        // reward of each into its pull_t
+        void pullMany(pull_t *pulls, size_t n);
+
         // total number of times any arm is pulled
         size_t trials() const;
 
@@ -179,8 +269,8 @@ class StochasticBanditProblem {
         // how much reward has been accumulated so far by pulling an arm
         double cummulativeReward() const;
 
-        // the beta arm with full knowledge of the latents
-        size_t bestArm() const;
+        // the beta arm with full knowledge of the latents, in O(1)
+        size_t bestArm() const { return m_best_arm; }
 
         // reset the underlying true reward distribution
         void reset();
@@ -194,15 +284,28 @@ class StochasticBanditProblem {
 
     private:
 
-        mutable std::default_random_engine m_generator;
+        // apply the change scheduled at the current trial
+        void change();
+
+        // recompute the cached best arm and its value
+        void refreshBest();
+
+        mutable RandomEngine m_generator;
 
         std::unique_ptr<ChangeSchedule> m_change_schedule;
 
         size_t m_num_trials = 0;
         double m_cumm_reward = 0.0;
 
+        // the trial at which the next change occurs
+        size_t m_next_changepoint;
+
         std::vector<double> m_thetas;
 
+        // the best arm, and its value, which change only with the thetas
+        size_t m_best_arm = 0;
+        double m_best_theta = 0.0;
+
         double m_exp_cumm_reward = 0.0;
 };
 
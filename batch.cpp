@@ -0,0 +1,397 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ==============================================================================
+
+#include "batch.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "beta.hpp"
+#include "common.hpp"
+
+
+/* -------------------------------------------------------------------------- */
+
+
+/* the draws of StochasticBanditProblem, in its order: the initial thetas,
+   then the variate of each pull, and fresh thetas at each change point
+   unless the schedule specifies them. */
+EnvironmentTrace::EnvironmentTrace(
+    size_t n_arms,
+    const rng_seed_t &seed,
+    std::unique_ptr<ChangeSchedule> cs,
+    size_t trials
+) :
+    m_arms(n_arms),
+    m_uniforms(trials)
+{
+    RandomEngine generator(seed);
+
+    auto segment = [&](size_t start) {
+        m_starts.push_back(start);
+        m_thetas.resize(m_starts.size() * m_arms);
+        m_best_theta.push_back(0.0);
+    };
+
+    segment(0);
+    for (size_t i = 0; i < m_arms; i++) m_thetas[i] = generator.uniform();
+
+    // a change at time 0 precedes every pull, so only marks the trajectory
+    if (trials > 0 && cs->changepoint(0)) m_changepoints.push_back(0);
+
+    size_t next = cs->nextChangepoint(0);
+
+    for (size_t t = 0; t < trials; t++) {
+        m_uniforms[t] = generator.uniform();
+
+        // a change after the last pull has no effect within the horizon
+        if (t + 1 != next || t + 1 == trials) continue;
+
+        next = cs->nextChangepoint(t + 1);
+        m_changepoints.push_back(t + 1);
+
+        // the best theta of the segment just ended
+        const double *prev = thetas(m_starts.size() - 1);
+        m_best_theta.back() = *std::max_element(prev, prev + m_arms);
+
+        segment(t + 1);
+        double *dest = &m_thetas[(m_starts.size() - 1) * m_arms];
+
+        auto new_thetas = cs->customArmInitialisation(t + 1);
+        if (new_thetas.empty()) {
+            for (size_t i = 0; i < m_arms; i++) dest[i] = generator.uniform();
+        } else {
+            assert(new_thetas.size() == m_arms);
+            std::copy(new_thetas.begin(), new_thetas.end(), dest);
+        }
+    }
+
+    const double *last = thetas(m_starts.size() - 1);
+    m_best_theta.back() = *std::max_element(last, last + m_arms);
+}
+
+
+bool EnvironmentTrace::changepoint(size_t t) const {
+    return std::binary_search(
+        m_changepoints.begin(), m_changepoints.end(), t
+    );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+BanditProblemBatch::BanditProblemBatch(
+    const EnvironmentTrace &trace,
+    size_t replicas
+) :
+    m_arms(trace.arms()),
+    m_replicas(replicas),
+    m_trace(trace),
+    m_cumm_reward(replicas, 0.0),
+    m_exp_cumm_reward(replicas, 0.0)
+{
+}
+
+
+/* every replica faces the same segment and variate, so compares its arm's
+   theta against the one variate. */
+void BanditProblemBatch::pull(const size_t *arms, int *rewards) {
+    assert(m_num_trials < m_trace.trials());
+
+    const double *thetas = m_trace.thetas(m_segment);
+    double best = m_trace.bestTheta(m_segment);
+    double u = m_trace.uniform(m_num_trials);
+
+    m_num_trials++;
+
+    for (size_t r = 0; r < m_replicas; r++) {
+        if (arms[r] >= m_arms) {
+            die_with_error("invalid arm index");
+        }
+
+        rewards[r] = u < thetas[arms[r]] ? 1 : 0;
+
+        m_cumm_reward[r] += rewards[r];
+        m_exp_cumm_reward[r] += best;
+    }
+
+    if (m_segment + 1 < m_trace.segments() &&
+        m_trace.segmentStart(m_segment + 1) == m_num_trials) {
+        m_segment++;
+    }
+}
+
+
+bool BanditProblemBatch::changepoint() const {
+    return m_trace.changepoint(m_num_trials);
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+StrategyBatch::StrategyBatch(
+    std::vector<std::unique_ptr<BanditStrategy>> agents
+) :
+    m_agents(std::move(agents))
+{
+    assert(!m_agents.empty());
+}
+
+
+void StrategyBatch::getActions(size_t *arms) {
+    for (size_t r = 0; r < m_agents.size(); r++) {
+        arms[r] = m_agents[r]->getAction();
+    }
+}
+
+
+void StrategyBatch::update(const size_t *arms, const int *rewards) {
+    for (size_t r = 0; r < m_agents.size(); r++) {
+        m_agents[r]->update(arms[r], rewards[r]);
+    }
+}
+
+
+std::string StrategyBatch::name() const {
+    return m_agents.front()->name();
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// draw a beta sample for each arm into samples, and return the
+// index of the largest, as done by the scalar Thompson strategies
+static size_t sampleBestArm(
+    RandomEngine &generator,
+    const double *alphas,
+    const double *betas,
+    std::vector<double> &samples
+) {
+    betaSamples(generator, alphas, betas, samples.data(), samples.size());
+
+    return std::distance(
+        samples.begin(),
+        std::max_element(samples.begin(), samples.end())
+    );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+ThompsonSamplingBatch::ThompsonSamplingBatch(
+    const std::vector<rng_seed_t> &seeds,
+    size_t n_arms
+) :
+    m_arms(n_arms),
+    m_generators(seeds.begin(), seeds.end()),
+    m_alphas(seeds.size() * n_arms, 0.5),
+    m_betas(seeds.size() * n_arms, 0.5),
+    m_samples(n_arms)
+{
+}
+
+
+void ThompsonSamplingBatch::getActions(size_t *arms) {
+    for (size_t r = 0; r < m_generators.size(); r++) {
+        arms[r] = sampleBestArm(
+            m_generators[r],
+            &m_alphas[r * m_arms],
+            &m_betas[r * m_arms],
+            m_samples
+        );
+    }
+}
+
+
+void ThompsonSamplingBatch::update(const size_t *arms, const int *rewards) {
+    for (size_t r = 0; r < m_generators.size(); r++) {
+        size_t s = r * m_arms + arms[r];
+        m_alphas[s] += rewards[r];
+        m_betas[s] += 1 - rewards[r];
+    }
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+ActivePTWBatch::ActivePTWBatch(size_t depth, size_t arms, size_t replicas) :
+    m_index(0),
+    m_depth(depth),
+    m_arms(arms),
+    m_replicas(replicas),
+    m_alphas(replicas * (depth + 1) * arms, KT_Alpha),
+    m_betas(replicas * (depth + 1) * arms, KT_Alpha),
+    m_stamps(replicas * (depth + 1) * arms, 0),
+    m_epochs(depth + 1, 0),
+    m_log_marginal((depth + 1) * replicas, 0.0),
+    m_log_weighted((depth + 1) * replicas, 0.0),
+    m_log_buf((depth + 1) * replicas, 0.0),
+    m_level_posterior(replicas),
+    m_level_sampler(replicas),
+    m_level_posterior_stale(replicas, true)
+{
+    ActivePTW::priorWeights(arms, LogStopWeight, LogSplitWeight);
+
+    assert(m_depth >= 1 && m_depth < 64);
+}
+
+
+void ActivePTWBatch::update(const int *rewards, const size_t *arms) {
+    assert(m_index < (static_cast<index_t>(1) << m_depth));
+
+    // the change point is shared by every replica
+    size_t i = ActivePTW::mscb(m_index + 1, m_depth);
+
+    // all replicas reset the same levels, so share their epochs
+    for (size_t j = i + 1; j <= m_depth; j++) m_epochs[j]++;
+
+    for (size_t r = 0; r < m_replicas; r++) {
+        double *log_marginal = &m_log_marginal[cell(0, r)];
+        double *log_weighted = &m_log_weighted[cell(0, r)];
+        double *log_buf = &m_log_buf[cell(0, r)];
+
+        // save weighted probability in change point's parent
+        log_buf[i] = log_weighted[i + 1];
+
+        // now reset statistics from the change point downwards
+        for (size_t j = i + 1; j <= m_depth; j++) {
+            log_marginal[j] = 0.0;
+            log_weighted[j] = 0.0;
+            log_buf[j] = 0.0;
+        }
+
+        // update the KT estimator of the pulled arm at every level
+        for (size_t j = 0; j <= m_depth; j++) {
+            size_t s = slot(r, j, arms[r]);
+
+            if (m_stamps[s] != m_epochs[j]) {
+                m_alphas[s] = KT_Alpha;
+                m_betas[s] = KT_Alpha;
+                m_stamps[s] = m_epochs[j];
+            }
+
+            ActivePTW::countKT(
+                rewards[r], m_alphas[s], m_betas[s], log_marginal[j], nullptr
+            );
+        }
+
+        ActivePTW::weigh(
+            m_depth, LogStopWeight, LogSplitWeight, log_marginal, log_buf,
+            log_weighted, nullptr
+        );
+    }
+
+    m_index++;
+    std::fill(
+        m_level_posterior_stale.begin(), m_level_posterior_stale.end(), true
+    );
+}
+
+
+const std::vector<double> &ActivePTWBatch::levelPosterior(size_t r) const {
+    refreshLevelPosterior(r);
+
+    return m_level_posterior[r];
+}
+
+
+const AliasTable &ActivePTWBatch::levelSampler(size_t r) const {
+    refreshLevelPosterior(r);
+
+    return m_level_sampler[r];
+}
+
+
+void ActivePTWBatch::refreshLevelPosterior(size_t r) const {
+    if (!m_level_posterior_stale[r]) return;
+
+    std::vector<double> &dest = m_level_posterior[r];
+    dest.resize(m_depth + 1);
+    ActivePTW::computeLevelPosterior(
+        m_depth, LogStopWeight, &m_log_marginal[cell(0, r)],
+        &m_log_weighted[cell(0, r)], dest.data()
+    );
+
+    m_level_sampler[r].build(dest);
+    m_level_posterior_stale[r] = false;
+}
+
+
+void ActivePTWBatch::posteriors(
+    size_t r,
+    size_t level,
+    double *alphas,
+    double *betas
+) const {
+    const double *a = &m_alphas[slot(r, level, 0)];
+    const double *b = &m_betas[slot(r, level, 0)];
+    const uint64_t *stamps = &m_stamps[slot(r, level, 0)];
+    const uint64_t epoch = m_epochs[level];
+
+    for (size_t i = 0; i < m_arms; i++) {
+        bool fresh = stamps[i] == epoch;
+        alphas[i] = fresh ? a[i] : KT_Alpha;
+        betas[i] = fresh ? b[i] : KT_Alpha;
+    }
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+ActivePTWBatchStrategy::ActivePTWBatchStrategy(
+    const std::vector<rng_seed_t> &seeds,
+    size_t n_arms,
+    size_t depth
+) :
+    m_arms(n_arms),
+    m_generators(seeds.begin(), seeds.end()),
+    m_model(depth, n_arms, seeds.size()),
+    m_alphas(n_arms),
+    m_betas(n_arms)
+{
+}
+
+
+void ActivePTWBatchStrategy::getActions(size_t *arms) {
+    for (size_t r = 0; r < m_generators.size(); r++) {
+        size_t level = m_model.levelSampler(r).sample(m_generators[r]);
+        m_model.posteriors(r, level, m_alphas.data(), m_betas.data());
+
+        // the samples overwrite the gathered alphas, as in ActivePTW
+        arms[r] = sampleBestArm(
+            m_generators[r], m_alphas.data(), m_betas.data(), m_alphas
+        );
+    }
+}
+
+
+void ActivePTWBatchStrategy::update(const size_t *arms, const int *rewards) {
+    m_model.update(rewards, arms);
+}
+
+
+/* -------------------------------------------------------------------------- */
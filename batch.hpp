@@ -0,0 +1,332 @@
+#ifndef __BATCH_HPP__
+#define __BATCH_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "alias.hpp"
+#include "bandits.hpp"
+#include "ptw.hpp"
+#include "rng.hpp"
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// Batched simulation of many independent bandit replicas in lockstep. The
+// state of every replica is held in [replica][...] arrays, and each call
+// steps the whole batch, so virtual dispatch is paid once per batch rather
+// than once per pull. Given the same seeds, each replica behaves exactly as
+// the corresponding scalar StochasticBanditProblem / BanditStrategy would.
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// the trajectory of a bernoulli stochastic bandit problem over a horizon:
+// the thetas of each segment between change points, and the uniform variate
+// each pull's reward is drawn with. a problem draws these the same way
+// whichever arms are pulled, so the trajectory of an environment is common
+// to every agent facing it, and can be generated once and replayed to all
+// of them, which also pairs their regrets.
+class EnvironmentTrace {
+
+    public:
+
+        // the first trials pulls of a problem with n_arms arms, drawn with
+        // seed under the given schedule
+        EnvironmentTrace(
+            size_t n_arms,
+            const rng_seed_t &seed,
+            std::unique_ptr<ChangeSchedule> cs,
+            size_t trials
+        );
+
+        size_t arms() const { return m_arms; }
+
+        size_t trials() const { return m_uniforms.size(); }
+
+        // the number of segments, and the time at which segment k begins
+        size_t segments() const { return m_starts.size(); }
+        size_t segmentStart(size_t k) const { return m_starts[k]; }
+
+        // the latent reward probabilities of each arm during segment k
+        const double *thetas(size_t k) const { return &m_thetas[k * m_arms]; }
+
+        // the best of those probabilities
+        double bestTheta(size_t k) const { return m_best_theta[k]; }
+
+        // the variate compared against the theta of the arm pulled at t
+        double uniform(size_t t) const { return m_uniforms[t]; }
+
+        // did a change occur at time t
+        bool changepoint(size_t t) const;
+
+    private:
+
+        size_t m_arms;
+
+        // the change points before the horizon, each starting a segment
+        std::vector<size_t> m_changepoints;
+
+        // per segment start times, [segment][arm] thetas and best theta
+        std::vector<size_t> m_starts;
+        std::vector<double> m_thetas;
+        std::vector<double> m_best_theta;
+
+        std::vector<double> m_uniforms;
+};
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// a batch of bernoulli stochastic bandit problems sharing one environment
+class BanditProblemBatch {
+
+    public:
+
+        // replicas replicas each replaying the same trace, which must
+        // outlive the batch, and behaving exactly as the problem generating
+        // it would, for up to trace.trials() pulls
+        BanditProblemBatch(const EnvironmentTrace &trace, size_t replicas);
+
+        // replica r pulls arm arms[r], receiving reward rewards[r]
+        void pull(const size_t *arms, int *rewards);
+
+        // total number of times each replica has pulled an arm
+        size_t trials() const { return m_num_trials; }
+
+        // the number of arms in each bandit problem
+        size_t arms() const { return m_arms; }
+
+        // the number of replicas
+        size_t replicas() const { return m_replicas; }
+
+        // the regret accumulated so far by a given replica
+        double regret(size_t r) const {
+            return m_exp_cumm_reward[r] - m_cumm_reward[r];
+        }
+
+        // did a change just occur at the current timestep
+        bool changepoint() const;
+
+    private:
+
+        size_t m_arms;
+        size_t m_replicas;
+        size_t m_num_trials = 0;
+
+        // the trace replayed, and its current segment
+        const EnvironmentTrace &m_trace;
+        size_t m_segment = 0;
+
+        // per replica statistics
+        std::vector<double> m_cumm_reward;
+        std::vector<double> m_exp_cumm_reward;
+};
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// an interface describing a bandit strategy over a batch of replicas
+class BatchBanditStrategy {
+
+    public:
+
+        // write the action chosen by each replica to arms
+        virtual void getActions(size_t *arms) = 0;
+
+        // update each replica's internal state after it
+        // pulled arms[r] and received reward rewards[r]
+        virtual void update(const size_t *arms, const int *rewards) = 0;
+
+        // the number of replicas
+        virtual size_t replicas() const = 0;
+
+        // name of the method, e.g. UCB
+        virtual std::string name() const = 0;
+
+        virtual ~BatchBanditStrategy() = default;
+};
+
+
+// the fallback for strategies without a native batched implementation,
+// which runs a scalar strategy for each replica
+class StrategyBatch : public BatchBanditStrategy {
+
+    public:
+
+        StrategyBatch(std::vector<std::unique_ptr<BanditStrategy>> agents);
+
+        void getActions(size_t *arms) override;
+
+        void update(const size_t *arms, const int *rewards) override;
+
+        size_t replicas() const override { return m_agents.size(); }
+
+        std::string name() const override;
+
+    private:
+
+        std::vector<std::unique_ptr<BanditStrategy>> m_agents;
+};
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// Thompson sampling over a batch of replicas
+class ThompsonSamplingBatch : public BatchBanditStrategy {
+
+    public:
+
+        // one replica per seed
+        ThompsonSamplingBatch(
+            const std::vector<rng_seed_t> &seeds,
+            size_t n_arms
+        );
+
+        void getActions(size_t *arms) override;
+
+        void update(const size_t *arms, const int *rewards) override;
+
+        size_t replicas() const override { return m_generators.size(); }
+
+        std::string name() const override { return "TS"; }
+
+    private:
+
+        size_t m_arms;
+        std::vector<RandomEngine> m_generators;
+
+        // [replica][arm] beta posterior parameters
+        std::vector<double> m_alphas;
+        std::vector<double> m_betas;
+
+        // scratch space for the beta samples of one replica
+        std::vector<double> m_samples;
+};
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// Active Partition Tree Weighting over a batch of replicas. since every
+// replica processes one pull per step, all replicas share the same change
+// point and reset schedule, which is computed once per batch; the per level
+// recurrences then run over contiguous [level][replica] arrays.
+class ActivePTWBatch {
+
+    public:
+
+        typedef ActivePTW::index_t index_t;
+
+        ActivePTWBatch(size_t depth, size_t arms, size_t replicas);
+
+        // replica r processes the pull of arm arms[r] with reward rewards[r]
+        void update(const int *rewards, const size_t *arms);
+
+        // the posterior probability of each level for a given replica,
+        // computed at most once between updates
+        const std::vector<double> &levelPosterior(size_t r) const;
+
+        // a sampler for the level posterior of a given replica
+        const AliasTable &levelSampler(size_t r) const;
+
+        // write the beta posterior parameters of every arm at a given level
+        // of a given replica into the caller provided arrays
+        void posteriors(
+            size_t r, size_t level,
+            double *alphas, double *betas
+        ) const;
+
+        // the number of replicas
+        size_t replicas() const { return m_replicas; }
+
+    private:
+
+        // the location of an arm's statistics at a given level and replica
+        size_t slot(size_t r, size_t level, size_t arm) const {
+            return (r * (m_depth + 1) + level) * m_arms + arm;
+        }
+
+        // the location of a level's statistics for a given replica
+        size_t cell(size_t level, size_t r) const {
+            return r * (m_depth + 1) + level;
+        }
+
+        // recompute the level posterior and sampler of a replica if stale
+        void refreshLevelPosterior(size_t r) const;
+
+        index_t m_index;
+        size_t m_depth;
+        size_t m_arms;
+        size_t m_replicas;
+
+        // [replica][level][arm] statistics, lazily cleared as in ActivePTW.
+        // all replicas reset a level together, so the epochs are shared
+        std::vector<double> m_alphas;
+        std::vector<double> m_betas;
+        std::vector<uint64_t> m_stamps;
+        std::vector<uint64_t> m_epochs;
+
+        // [replica][level] statistics, so that each replica's levels are
+        // contiguous, as ActivePTW's are
+        std::vector<double> m_log_marginal;
+        std::vector<double> m_log_weighted;
+        std::vector<double> m_log_buf;
+
+        // cached per replica level posteriors, invalidated by each update
+        mutable std::vector<std::vector<double>> m_level_posterior;
+        mutable std::vector<AliasTable> m_level_sampler;
+        mutable std::vector<bool> m_level_posterior_stale;
+
+        // parameters to define the PTW prior, as in ActivePTW
+        double LogSplitWeight;
+        double LogStopWeight;
+
+        static constexpr double KT_Alpha = ActivePTW::KT_Alpha;
+};
+
+
+// the ActivePTW Thompson sampling strategy over a batch of replicas
+class ActivePTWBatchStrategy : public BatchBanditStrategy {
+
+    public:
+
+        // one replica per seed
+        ActivePTWBatchStrategy(
+            const std::vector<rng_seed_t> &seeds,
+            size_t n_arms,
+            size_t depth
+        );
+
+        void getActions(size_t *arms) override;
+
+        void update(const size_t *arms, const int *rewards) override;
+
+        size_t replicas() const override { return m_generators.size(); }
+
+        std::string name() const override { return "ActivePTW"; }
+
+    private:
+
+        size_t m_arms;
+        std::vector<RandomEngine> m_generators;
+        ActivePTWBatch m_model;
+
+        // scratch space for gathering the posteriors of one replica
+        std::vector<double> m_alphas;
+        std::vector<double> m_betas;
+};
+
+
+/* -------------------------------------------------------------------------- */
+
+
+#endif // __BATCH_HPP__
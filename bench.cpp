@@ -0,0 +1,576 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ==============================================================================
+
+#include "bench.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "beta.hpp"
+#include "common.hpp"
+#include "concurrent.hpp"
+#include "fastlog.hpp"
+#include "ptw.hpp"
+#include "ptw_static.hpp"
+#include "rng.hpp"
+#include "store.hpp"
+#include "ts.hpp"
+
+
+/* -------------------------------------------------------------------------- */
+
+
+namespace {
+
+// the shape and length of the PTW benchmarks
+constexpr size_t BenchDepth = 20;
+constexpr size_t BenchArms = 10;
+constexpr size_t BenchOps = 1 << 18;
+
+// the number of instances over which the pooled store benchmark spreads
+constexpr size_t BenchInstances = 4096;
+
+// each kernel is timed this many times, keeping the fastest
+constexpr size_t BenchRepeats = 5;
+
+// the precision of the table driven log arithmetic benchmarked
+constexpr double BenchLogPrecision = 1e-6;
+
+// the agent and problem benchmarks check their budget this often
+constexpr size_t BenchBudgetStride = 256;
+
+// the draws per parameter pair checked of the beta sampler
+constexpr size_t BetaCheckSamples = 20000;
+
+// the problems over which table driven PTW regret is checked against exact
+// PTW regret, and the relative difference in mean regret tolerated
+constexpr size_t RegretCheckProblems = 8;
+constexpr size_t RegretCheckTrials = 10000;
+constexpr double RegretCheckRate = 0.002;
+constexpr double RegretCheckTolerance = 0.02;
+
+// results are accumulated here so the timed work is not optimised away
+volatile double g_sink = 0.0;
+
+
+/* the fastest of several timings of fn, which performs ops operations,
+   in nanoseconds per operation */
+template <class Fn>
+double timeKernel(size_t ops, Fn fn) {
+    double best = std::numeric_limits<double>::infinity();
+
+    for (size_t i = 0; i < BenchRepeats; i++) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto stop = std::chrono::steady_clock::now();
+
+        std::chrono::duration<double, std::nano> elapsed = stop - start;
+        best = std::min(best, elapsed.count() / static_cast<double>(ops));
+    }
+
+    return best;
+}
+
+
+/* the number of bits to the left of the most significant location at which
+   t-1 and t-2 differ, by examining each bit in turn */
+size_t bitwiseMscb(ActivePTW::index_t t, size_t depth) {
+    if (t == 1) return 0;
+
+    for (size_t cnt = 0; cnt < depth; cnt++) {
+        ActivePTW::index_t mask = static_cast<uint64_t>(1) << (depth - 1 - cnt);
+        if (((t - 1) & mask) != ((t - 2) & mask)) return cnt;
+    }
+
+    return depth;
+}
+
+
+/* the nanoseconds per step of up to steps calls of step(t), stopping early
+   once budget seconds have elapsed */
+template <class Fn>
+double timeSteps(size_t steps, double budget, Fn step) {
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed(0.0);
+
+    size_t t = 0;
+    while (t < steps) {
+        size_t stop = std::min(steps, t + BenchBudgetStride);
+        for (; t < stop; t++) step(t);
+
+        elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() >= budget) break;
+    }
+
+    return 1e9 * elapsed.count() / static_cast<double>(t);
+}
+
+
+/* a fixed stream of pulls with arm dependent reward rates */
+std::vector<std::pair<size_t, int>> benchPulls(size_t n) {
+    RandomEngine generator(rng_seed_t(0));
+
+    std::vector<std::pair<size_t, int>> pulls(n);
+    for (auto &p : pulls) {
+        p.first = static_cast<size_t>(generator() % BenchArms);
+        double theta = static_cast<double>(p.first + 1) / (BenchArms + 1);
+        p.second = generator.uniform() < theta ? 1 : 0;
+    }
+
+    return pulls;
+}
+
+/* n draws of Beta(a, b) by the gamma ratio of std::gamma_distribution, the
+   sampler betaSamples replaced, as a reference. */
+std::vector<double> referenceBetaSamples(double a, double b, size_t n) {
+    RandomEngine generator(rng_seed_t(5));
+    std::gamma_distribution<double> x_dist(a, 1.0), y_dist(b, 1.0);
+
+    std::vector<double> samples(n);
+    for (auto &z : samples) {
+        double x = x_dist(generator);
+        double y = y_dist(generator);
+        z = x / (x + y);
+    }
+
+    return samples;
+}
+
+
+/* whether betaSamples draws Beta(a, b) variates: the mean of many draws
+   must be within a few standard errors of a/(a+b), and a two sample
+   Kolmogorov-Smirnov test against the reference sampler must not reject at
+   the 0.1% level. the seeds are fixed, so the check is deterministic. */
+bool checkBetaSampler(double a, double b) {
+    constexpr size_t n = BetaCheckSamples;
+
+    RandomEngine generator(rng_seed_t(6));
+    std::vector<double> alphas(n, a), betas(n, b), samples(n);
+    betaSamples(generator, alphas.data(), betas.data(), samples.data(), n);
+
+    double mean = std::accumulate(samples.begin(), samples.end(), 0.0) / n;
+    double mu = a / (a + b);
+    double var = a * b / ((a + b) * (a + b) * (a + b + 1.0));
+    if (std::abs(mean - mu) > 6.0 * std::sqrt(var / n)) return false;
+
+    auto reference = referenceBetaSamples(a, b, n);
+    std::sort(samples.begin(), samples.end());
+    std::sort(reference.begin(), reference.end());
+
+    // the largest gap between the empirical distribution functions
+    double ks = 0.0;
+    for (size_t i = 0, j = 0; i < n && j < n; ) {
+        if (samples[i] <= reference[j]) {
+            i++;
+        } else {
+            j++;
+        }
+        ks = std::max(ks, std::abs(static_cast<double>(i) -
+            static_cast<double>(j)) / n);
+    }
+
+    return ks < 1.95 * std::sqrt(2.0 / n);
+}
+
+
+/* the mean regret of ActivePTW, using log arithmetic of the given precision
+   or exact if 0, over fixed problems with geometrically distributed change
+   points. every problem and agent is seeded the same way whatever the
+   precision, so the regrets of two precisions are paired. */
+double meanPTWRegret(double precision) {
+    size_t depth = ActivePTW::depthForHorizon(RegretCheckTrials);
+    double total = 0.0;
+
+    for (size_t i = 0; i < RegretCheckProblems; i++) {
+        StochasticBanditProblem problem(
+            BenchArms, rng_seed_t(7, i),
+            std::make_unique<GeometricAbruptChangeSchedule>(
+                RegretCheckRate, RegretCheckTrials, rng_seed_t(8, i)
+            )
+        );
+        ActivePTWBanditStrategy agent(
+            rng_seed_t(9, i), BenchArms, depth, false, precision
+        );
+
+        for (size_t t = 0; t < RegretCheckTrials; t++) {
+            size_t arm = agent.getAction();
+            agent.update(arm, problem.pull(arm) > 0.0 ? 1 : 0);
+        }
+
+        total += problem.bestHindsightExpectedReturn() -
+            problem.cummulativeReward();
+    }
+
+    return total / RegretCheckProblems;
+}
+
+} // namespace
+
+
+/* -------------------------------------------------------------------------- */
+
+
+std::vector<bench_result_t> benchPTW() {
+    std::vector<bench_result_t> results;
+    auto suffix = "_d" + std::to_string(BenchDepth) +
+        "_a" + std::to_string(BenchArms);
+
+    // check every input of the mscb benchmark against the definition
+    for (size_t t = 1; t <= BenchOps; t++) {
+        size_t depth = 1 + t % (BenchDepth + 1);
+        if (ActivePTW::mscb(t, depth) != bitwiseMscb(t, depth)) {
+            die_with_error("mscb disagrees with its bitwise definition.");
+        }
+    }
+
+    double ns_mscb = timeKernel(BenchOps, []() {
+        size_t acc = 0;
+        for (size_t t = 1; t <= BenchOps; t++) {
+            acc += ActivePTW::mscb(t, 1 + t % (BenchDepth + 1));
+        }
+        g_sink = g_sink + static_cast<double>(acc);
+    });
+    results.push_back({"mscb", ns_mscb});
+
+    // check the table driven logAdd against the exact one over a fine grid
+    // of differences, including those beyond the table
+    const auto &table = LogAddTable::forPrecision(BenchLogPrecision);
+    for (size_t i = 0; i <= BenchOps; i++) {
+        double d = 40.0 * static_cast<double>(i) / BenchOps;
+        double err = std::abs(table.logAdd(-d, 0.0) - logAdd(-d, 0.0));
+        if (err > BenchLogPrecision) {
+            die_with_error("logAdd table exceeds its precision bound.");
+        }
+    }
+
+    // the table driven model must also learn as well as the exact one
+    double exact_regret = meanPTWRegret(0.0);
+    double table_regret = meanPTWRegret(BenchLogPrecision);
+    if (std::abs(table_regret - exact_regret) >
+        RegretCheckTolerance * exact_regret) {
+        die_with_error("table driven PTW regret strays from exact regret.");
+    }
+
+    double ns_log_add = timeKernel(BenchOps, [&]() {
+        double acc = 0.0;
+        for (size_t i = 0; i < BenchOps; i++) {
+            acc += logAdd(-static_cast<double>(i & 1023) / 64.0, acc * 1e-9);
+        }
+        g_sink = g_sink + acc;
+    });
+    results.push_back({"log_add", ns_log_add});
+
+    double ns_log_add_fast = timeKernel(BenchOps, [&]() {
+        double acc = 0.0;
+        for (size_t i = 0; i < BenchOps; i++) {
+            double x = -static_cast<double>(i & 1023) / 64.0;
+            acc += table.logAdd(x, acc * 1e-9);
+        }
+        g_sink = g_sink + acc;
+    });
+    results.push_back({"log_add_fast", ns_log_add_fast});
+
+    auto pulls = benchPulls(BenchOps);
+
+    double ns_update = timeKernel(BenchOps, [&]() {
+        ActivePTW model(BenchDepth, BenchArms);
+        for (const auto &p : pulls) model.update(p.second, p.first);
+        g_sink = g_sink + model.logMarginal();
+    });
+    results.push_back({"ptw_update" + suffix, ns_update});
+
+    double ns_fast = timeKernel(BenchOps, [&]() {
+        ActivePTW model(BenchDepth, BenchArms, false, BenchLogPrecision);
+        for (const auto &p : pulls) model.update(p.second, p.first);
+        g_sink = g_sink + model.logMarginal();
+    });
+    results.push_back({"ptw_update_fast" + suffix, ns_fast});
+
+    double ns_static = timeKernel(BenchOps, [&]() {
+        typedef StaticActivePTW<BenchDepth, BenchArms> model_t;
+        auto model = std::make_unique<model_t>();
+        for (const auto &p : pulls) model->update(p.second, p.first);
+        g_sink = g_sink + model->logMarginal();
+    });
+    results.push_back({"static_ptw_update" + suffix, ns_static});
+
+    // an update followed by the level posterior refresh that the next
+    // action requires
+    double ns_sampler = timeKernel(BenchOps, [&]() {
+        ActivePTW model(BenchDepth, BenchArms);
+        for (const auto &p : pulls) {
+            model.update(p.second, p.first);
+            g_sink = g_sink + model.levelPosterior().front();
+        }
+    });
+    results.push_back({"ptw_update_sampler" + suffix, ns_sampler});
+
+    // updates spread over many instances, each a separate model, or a slot
+    // of a pooled store. creating the instances is part of the timing
+    std::vector<uint64_t> ids(BenchOps);
+    RandomEngine id_generator(rng_seed_t(4));
+    for (auto &id : ids) id = id_generator() % BenchInstances;
+
+    auto instances = "_i" + std::to_string(BenchInstances);
+
+    double ns_instances = timeKernel(BenchOps, [&]() {
+        std::vector<std::unique_ptr<ActivePTW>> models(BenchInstances);
+        for (auto &m : models) m.reset(new ActivePTW(BenchDepth, BenchArms));
+
+        for (size_t i = 0; i < BenchOps; i++) {
+            models[ids[i]]->update(pulls[i].second, pulls[i].first);
+        }
+        g_sink = g_sink + models[0]->logMarginal();
+    });
+    results.push_back({"ptw_instances_update" + instances, ns_instances});
+
+    double ns_store = timeKernel(BenchOps, [&]() {
+        ActivePTWStore store(BenchDepth, BenchArms);
+        store.reserve(BenchInstances);
+        for (size_t id = 0; id < BenchInstances; id++) store.create(id);
+
+        for (size_t i = 0; i < BenchOps; i++) {
+            store.update(ids[i], pulls[i].first, pulls[i].second);
+        }
+        g_sink = g_sink + store.logMarginal(0);
+    });
+    results.push_back({"store_update" + instances, ns_store});
+
+    ActivePTW model(BenchDepth, BenchArms);
+    for (const auto &p : pulls) model.update(p.second, p.first);
+
+    double ns_gather = timeKernel(BenchOps, [&]() {
+        std::vector<double> alphas(BenchArms), betas(BenchArms);
+        double acc = 0.0;
+        for (size_t i = 0; i < BenchOps; i++) {
+            model.posteriors(i % (BenchDepth + 1), alphas.data(), betas.data());
+            acc += alphas[i % BenchArms];
+        }
+        g_sink = g_sink + acc;
+    });
+    results.push_back({"ptw_posteriors" + suffix, ns_gather});
+
+    // check the beta sampler over small and large parameters, including
+    // those below 1, which take the boosted path
+    const std::pair<double, double> beta_params[] = {
+        {0.05, 0.5}, {0.5, 0.5}, {0.5, 3.0}, {1.0, 1.0},
+        {2.5, 0.7}, {30.0, 70.0}, {500.5, 20.5}, {1000.0, 1000.0}
+    };
+    for (const auto &ab : beta_params) {
+        if (!checkBetaSampler(ab.first, ab.second)) {
+            die_with_error("beta sampler disagrees with its distribution.");
+        }
+    }
+
+    // a beta sample for every arm, from the gathered posteriors of a level
+    double ns_beta = timeKernel(BenchOps, [&]() {
+        RandomEngine generator(rng_seed_t(1));
+        std::vector<double> alphas(BenchArms), betas(BenchArms);
+        std::vector<double> samples(BenchArms);
+        model.posteriors(0, alphas.data(), betas.data());
+
+        double acc = 0.0;
+        for (size_t i = 0; i < BenchOps; i += BenchArms) {
+            betaSamples(
+                generator, alphas.data(), betas.data(), samples.data(),
+                BenchArms
+            );
+            acc += samples[i % BenchArms];
+        }
+        g_sink = g_sink + acc;
+    });
+    results.push_back({"beta_sample", ns_beta});
+
+    return results;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+double benchAgent(
+    BanditStrategy &agent,
+    size_t arms,
+    size_t trials,
+    double budget
+) {
+    RandomEngine generator(rng_seed_t(2));
+
+    std::vector<double> theta(arms);
+    for (auto &p : theta) p = generator.uniform();
+
+    return timeSteps(trials, budget, [&](size_t) {
+        size_t arm = agent.getAction();
+        agent.update(arm, generator.uniform() < theta[arm] ? 1 : 0);
+    });
+}
+
+
+double benchProblem(
+    StochasticBanditProblem &problem,
+    size_t pulls,
+    double budget
+) {
+    size_t arms = problem.arms();
+    double acc = 0.0;
+
+    double ns = timeSteps(pulls, budget, [&](size_t t) {
+        acc += problem.pull(t % arms);
+    });
+    g_sink = g_sink + acc;
+
+    return ns;
+}
+
+
+/* the writer learns from a stream of pulls cycling through the arms, as
+   fast as it can, until its model's horizon or the budget is reached.
+   meanwhile each reader chooses actions, and the decisions of all readers
+   over the wall clock time are counted. */
+double benchServing(size_t arms, size_t readers, double budget) {
+    ConcurrentActivePTW server(arms, BenchDepth);
+    std::atomic<bool> stop(false);
+
+    RandomEngine generator(rng_seed_t(2));
+    std::vector<double> theta(arms);
+    for (auto &p : theta) p = generator.uniform();
+
+    // each reader's count and sink, folded into g_sink once it has joined
+    std::vector<uint64_t> decisions(readers, 0);
+    std::vector<size_t> sinks(readers, 0);
+    std::vector<std::thread> threads;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t r = 0; r < readers; r++) {
+        auto reader = server.reader(rng_seed_t(3).derive(r));
+        threads.emplace_back([&stop, &decisions, &sinks, r, reader]() mutable {
+            uint64_t n = 0;
+            size_t acc = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                acc += reader.getAction();
+                n++;
+            }
+            decisions[r] = n;
+            sinks[r] = acc;
+        });
+    }
+
+    std::thread writer([&]() {
+        ActivePTW::index_t horizon =
+            static_cast<ActivePTW::index_t>(1) << BenchDepth;
+
+        for (ActivePTW::index_t t = 0; t < horizon; t++) {
+            if (stop.load(std::memory_order_relaxed)) break;
+
+            size_t arm = static_cast<size_t>(t % arms);
+            server.update(arm, generator.uniform() < theta[arm] ? 1 : 0);
+        }
+    });
+
+    std::chrono::duration<double> elapsed(0.0);
+    while (elapsed.count() < budget) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+
+    stop.store(true, std::memory_order_relaxed);
+    writer.join();
+    for (auto &t : threads) t.join();
+    elapsed = std::chrono::steady_clock::now() - start;
+
+    uint64_t total = 1;
+    for (auto n : decisions) total += n;
+    for (auto acc : sinks) g_sink = g_sink + static_cast<double>(acc);
+
+    return 1e9 * elapsed.count() / static_cast<double>(total);
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+void writeBenchResults(
+    std::ostream &out,
+    const std::vector<bench_result_t> &results
+) {
+    for (const auto &r : results) {
+        out << r.name << "," << r.ns_per_op << "," << 1e9 / r.ns_per_op
+            << '\n';
+    }
+}
+
+
+bool readBenchResults(
+    const std::string &path,
+    std::vector<bench_result_t> &results
+) {
+    std::ifstream in(path);
+    if (!in) return false;
+
+    std::string line;
+    while (std::getline(in, line)) {
+        auto comma = line.find(',');
+        if (comma == std::string::npos) continue;
+
+        std::istringstream value(line.substr(comma + 1));
+        bench_result_t r{line.substr(0, comma), 0.0};
+        if (value >> r.ns_per_op) results.push_back(r);
+    }
+
+    return true;
+}
+
+
+size_t countRegressions(
+    const std::vector<bench_result_t> &results,
+    const std::vector<bench_result_t> &baseline,
+    double tolerance
+) {
+    size_t regressions = 0;
+
+    for (const auto &r : results) {
+        for (const auto &b : baseline) {
+            if (r.name != b.name || r.ns_per_op <= b.ns_per_op * tolerance) {
+                continue;
+            }
+
+            std::cerr << "regression: " << r.name << " took " << r.ns_per_op
+                << "ns per op against a baseline of " << b.ns_per_op
+                << "ns" << std::endl;
+            regressions++;
+        }
+    }
+
+    return regressions;
+}
+
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,88 @@
+#ifndef __BENCH_HPP__
+#define __BENCH_HPP__
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "bandits.hpp"
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// the measured cost of one benchmarked kernel
+struct bench_result_t {
+    std::string name;
+    double ns_per_op;
+};
+
+
+// time the PTW hot paths: mscb, the exact and table driven logAdd, the update
+// of the exact, table driven and compile-time shaped models, the level
+// posterior refresh, updates spread over many separate models or over a
+// pooled store, the arm posterior gather and the beta sampling. the constant
+// time mscb is checked against its bitwise definition on every timed input, the
+// logAdd table against its precision bound, the regret of the table driven
+// model against that of the exact model on fixed problems, and the beta
+// sampler against the beta distribution's mean and a reference sampler,
+// dying with an error on any failure.
+std::vector<bench_result_t> benchPTW();
+
+
+// the nanoseconds per decision of an agent choosing, and learning from, up to
+// trials actions. rewards are drawn from a fixed stationary problem, so that
+// only the agent's own work is measured. the run stops early once budget
+// seconds have elapsed, so only its earliest decisions are then timed.
+double benchAgent(
+    BanditStrategy &agent,
+    size_t arms,
+    size_t trials,
+    double budget
+);
+
+
+// the nanoseconds per pull of up to pulls pulls of a problem, cycling through
+// its arms, and stopping early once budget seconds have elapsed
+double benchProblem(
+    StochasticBanditProblem &problem,
+    size_t pulls,
+    double budget
+);
+
+
+// the nanoseconds of wall clock time per decision of readers threads, each
+// choosing actions from a ConcurrentActivePTW model of arms arms while a
+// writer thread updates it, over budget seconds
+double benchServing(size_t arms, size_t readers, double budget);
+
+
+// write results as csv lines of the form kernel,ns_per_op,ops_per_sec
+void writeBenchResults(
+    std::ostream &out,
+    const std::vector<bench_result_t> &results
+);
+
+
+// read the kernel and ns_per_op of results previously written by
+// writeBenchResults, returning false if the file could not be read
+bool readBenchResults(
+    const std::string &path,
+    std::vector<bench_result_t> &results
+);
+
+
+// the number of kernels which are slower than their baseline by more than
+// a factor of tolerance, each of which is reported to std::cerr
+size_t countRegressions(
+    const std::vector<bench_result_t> &results,
+    const std::vector<bench_result_t> &baseline,
+    double tolerance
+);
+
+
+/* -------------------------------------------------------------------------- */
+
+
+#endif // __BENCH_HPP__
@@ -0,0 +1,94 @@
+#ifndef __BETA_HPP__
+#define __BETA_HPP__
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <random>
+
+
+/* -------------------------------------------------------------------------- */
+
+
+/* the logarithm of a Gamma(alpha, 1) variate, using the squeeze method of
+   Marsaglia and Tsang (2000). for alpha < 1, a Gamma(alpha+1, 1) variate is
+   boosted by U^(1/alpha), which is done in the log domain since for small
+   alpha the variate itself frequently underflows. */
+template <class URNG>
+double logGammaSample(
+    URNG &generator,
+    std::normal_distribution<double> &normal_dist,
+    std::uniform_real_distribution<double> &unit_dist,
+    double alpha
+) {
+    assert(alpha > 0.0);
+
+    double log_boost = 0.0;
+    if (alpha < 1.0) {
+        // uniform in (0, 1], so that the log is finite
+        double u = 1.0 - unit_dist(generator);
+        log_boost = std::log(u) / alpha;
+        alpha += 1.0;
+    }
+
+    const double d = alpha - 1.0 / 3.0;
+    const double c = 1.0 / std::sqrt(9.0 * d);
+
+    for (;;) {
+        double x, v;
+        do {
+            x = normal_dist(generator);
+            v = 1.0 + c * x;
+        } while (v <= 0.0);
+
+        v = v * v * v;
+        double u = unit_dist(generator);
+        double x2 = x * x;
+
+        // cheap squeeze test accepts the vast majority of proposals
+        if (u < 1.0 - 0.0331 * x2 * x2) {
+            return std::log(d * v) + log_boost;
+        }
+
+        if (u > 0.0 && std::log(u) < 0.5 * x2 + d * (1.0 - v + std::log(v))) {
+            return std::log(d * v) + log_boost;
+        }
+    }
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+/* draw n Beta variates, the i'th with parameters alphas[i] and betas[i], into
+   out. out may alias alphas or betas. the distributions are shared across the
+   whole batch, so the normal generator's spare value is not discarded. */
+template <class URNG>
+void betaSamples(
+    URNG &generator,
+    const double *alphas,
+    const double *betas,
+    double *out,
+    size_t n
+) {
+    std::normal_distribution<double> normal_dist(0.0, 1.0);
+    std::uniform_real_distribution<double> unit_dist(0.0, 1.0);
+
+    for (size_t i = 0; i < n; i++) {
+        // if X∼Gamma(a, 1), Y∼Gamma(b, 1) then Z = X/(X+Y) ~ Beta(a,b),
+        // computed as 1/(1+Y/X) to remain finite when X and Y underflow
+        double log_x = logGammaSample(
+            generator, normal_dist, unit_dist, alphas[i]
+        );
+        double log_y = logGammaSample(
+            generator, normal_dist, unit_dist, betas[i]
+        );
+        out[i] = 1.0 / (1.0 + std::exp(log_y - log_x));
+    }
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+#endif // __BETA_HPP__
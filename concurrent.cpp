@@ -0,0 +1,240 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ==============================================================================
+
+#include "concurrent.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#include "beta.hpp"
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// the KT prior, of every arm at a level until it is touched
+static const double KT_Alpha = 0.5;
+
+// the stamp of a view slot never written, which no generation reaches
+static const uint64_t Unwritten = ~static_cast<uint64_t>(0);
+
+
+/* -------------------------------------------------------------------------- */
+
+
+ConcurrentActivePTW::ConcurrentActivePTW(
+    size_t n_arms,
+    size_t depth,
+    double log_precision
+) :
+    m_model(depth, n_arms, false, log_precision),
+    m_arms(n_arms),
+    m_levels(depth + 1),
+    m_generations(depth + 1, 0),
+    m_published(0)
+{
+    size_t slots = m_levels * m_arms;
+    const auto &posterior = m_model.levelPosterior();
+
+    for (auto &view : m_views) {
+        view.seq.store(0, std::memory_order_relaxed);
+        view.posterior.reset(new std::atomic<double>[m_levels]);
+        view.generations.reset(new std::atomic<uint64_t>[m_levels]);
+        view.alphas.reset(new std::atomic<double>[slots]);
+        view.betas.reset(new std::atomic<double>[slots]);
+        view.stamps.reset(new std::atomic<uint64_t>[slots]);
+
+        for (size_t j = 0; j < m_levels; j++) {
+            view.posterior[j].store(posterior[j], std::memory_order_relaxed);
+            view.generations[j].store(0, std::memory_order_relaxed);
+        }
+        for (size_t s = 0; s < slots; s++) {
+            view.alphas[s].store(KT_Alpha, std::memory_order_relaxed);
+            view.betas[s].store(KT_Alpha, std::memory_order_relaxed);
+            view.stamps[s].store(Unwritten, std::memory_order_relaxed);
+        }
+    }
+
+    for (size_t b = 0; b < 2; b++) m_dirty[b].assign(slots, false);
+}
+
+
+ConcurrentActivePTW::Reader ConcurrentActivePTW::reader(
+    const rng_seed_t &seed
+) const {
+    return Reader(*this, seed);
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+/* the update resets every level below its change point, which the model
+   does by advancing their epochs; the views follow by advancing their
+   generations. arm is then updated at every level. */
+void ConcurrentActivePTW::apply(size_t arm, int reward) {
+    size_t depth = m_levels - 1;
+    size_t cp = ActivePTW::mscb(m_model.updates() + 1, depth);
+
+    for (size_t j = cp + 1; j <= depth; j++) m_generations[j]++;
+
+    m_model.update(reward, arm);
+
+    for (size_t j = 0; j <= depth; j++) {
+        size_t s = j * m_arms + arm;
+
+        for (size_t b = 0; b < 2; b++) {
+            if (m_dirty[b][s]) continue;
+            m_dirty[b][s] = true;
+            m_pending[b].push_back(s);
+        }
+    }
+}
+
+
+void ConcurrentActivePTW::publish() {
+    uint64_t published = m_published.load(std::memory_order_relaxed);
+    size_t b = static_cast<size_t>((published + 1) & 1);
+    view_t &view = m_views[b];
+
+    // mark the view as being written, before any of the writes
+    uint64_t seq = view.seq.load(std::memory_order_relaxed);
+    view.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const auto &posterior = m_model.levelPosterior();
+    for (size_t j = 0; j < m_levels; j++) {
+        view.posterior[j].store(posterior[j], std::memory_order_relaxed);
+        view.generations[j].store(
+            m_generations[j], std::memory_order_relaxed
+        );
+    }
+
+    for (size_t s : m_pending[b]) {
+        size_t level = s / m_arms;
+        auto ss = m_model.posterior(level, s % m_arms);
+
+        view.alphas[s].store(ss.first, std::memory_order_relaxed);
+        view.betas[s].store(ss.second, std::memory_order_relaxed);
+        view.stamps[s].store(
+            m_generations[level], std::memory_order_relaxed
+        );
+        m_dirty[b][s] = false;
+    }
+    m_pending[b].clear();
+
+    view.seq.store(seq + 2, std::memory_order_release);
+    m_published.store(published + 1, std::memory_order_release);
+}
+
+
+void ConcurrentActivePTW::update(size_t arm, int reward) {
+    apply(arm, reward);
+    publish();
+}
+
+
+void ConcurrentActivePTW::updateBatch(const pull_t *pulls, size_t n) {
+    for (size_t i = 0; i < n; i++) apply(pulls[i].arm, pulls[i].reward);
+    publish();
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+ConcurrentActivePTW::Reader::Reader(
+    const ConcurrentActivePTW &owner,
+    const rng_seed_t &seed
+) :
+    m_owner(&owner),
+    m_generator(seed),
+    m_posterior(owner.m_levels),
+    m_alphas(owner.m_arms),
+    m_betas(owner.m_arms)
+{
+}
+
+
+bool ConcurrentActivePTW::Reader::read(const view_t &view) {
+    uint64_t seq = view.seq.load(std::memory_order_acquire);
+    if (seq & 1) return false;
+
+    size_t levels = m_owner->m_levels;
+    size_t arms = m_owner->m_arms;
+
+    // sample a level in proportion to its posterior weight
+    double total = 0.0;
+    for (size_t j = 0; j < levels; j++) {
+        m_posterior[j] = view.posterior[j].load(std::memory_order_relaxed);
+        total += m_posterior[j];
+    }
+
+    double u = m_generator.uniform() * total;
+    size_t level = levels - 1;
+    for (size_t j = 0; j + 1 < levels; j++) {
+        if (u < m_posterior[j]) {
+            level = j;
+            break;
+        }
+        u -= m_posterior[j];
+    }
+
+    uint64_t generation =
+        view.generations[level].load(std::memory_order_relaxed);
+    size_t first = level * arms;
+
+    for (size_t i = 0; i < arms; i++) {
+        bool fresh = view.stamps[first + i].load(
+            std::memory_order_relaxed) == generation;
+
+        m_alphas[i] = fresh ?
+            view.alphas[first + i].load(std::memory_order_relaxed) : KT_Alpha;
+        m_betas[i] = fresh ?
+            view.betas[first + i].load(std::memory_order_relaxed) : KT_Alpha;
+    }
+
+    // order the reads before checking the view was not rewritten meanwhile
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return view.seq.load(std::memory_order_relaxed) == seq;
+}
+
+
+size_t ConcurrentActivePTW::Reader::getAction() {
+    for (;;) {
+        uint64_t published =
+            m_owner->m_published.load(std::memory_order_acquire);
+
+        if (read(m_owner->m_views[published & 1])) break;
+    }
+
+    betaSamples(
+        m_generator, m_alphas.data(), m_betas.data(), m_alphas.data(),
+        m_alphas.size()
+    );
+
+    return std::distance(
+        m_alphas.begin(),
+        std::max_element(m_alphas.begin(), m_alphas.end())
+    );
+}
+
+
+/* -------------------------------------------------------------------------- */
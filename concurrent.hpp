@@ -0,0 +1,142 @@
+#ifndef __CONCURRENT_HPP__
+#define __CONCURRENT_HPP__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "bandits.hpp"
+#include "ptw.hpp"
+#include "rng.hpp"
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// ActivePTW Thompson sampling for serving, where one writer thread learns
+// from rewards while any number of reader threads choose actions.
+//
+// after each update or batch of updates, the writer publishes the level
+// posterior and the per level beta parameters into one of two views, each
+// guarded by a sequence lock. a reader copies the parameters it needs from
+// the current view, and retries only if the writer has since lapped it,
+// rewriting that same view, so readers never block the writer nor each
+// other. a publication writes only the statistics changed since the view
+// was last written, and the levels reset by an update are invalidated by a
+// generation tag per level, as the model's epochs do, so it costs O(depth)
+// per update.
+//
+// a rolling model would reshape the views as it grows, so the depth is
+// fixed.
+class ConcurrentActivePTW {
+
+    struct view_t;
+
+    public:
+
+        // a reader's handle, which owns the generator and scratch space
+        // of one thread, and must be used only by that thread
+        class Reader {
+
+            public:
+
+                // get the action using a thompson sampling strategy
+                size_t getAction();
+
+            private:
+
+                friend class ConcurrentActivePTW;
+
+                Reader(
+                    const ConcurrentActivePTW &owner,
+                    const rng_seed_t &seed
+                );
+
+                // sample a level from a view's level posterior, and copy the
+                // arm posteriors at that level, returning false if the view
+                // was being rewritten meanwhile
+                bool read(const view_t &view);
+
+                const ConcurrentActivePTW *m_owner;
+                RandomEngine m_generator;
+
+                std::vector<double> m_posterior;
+                std::vector<double> m_alphas;
+                std::vector<double> m_betas;
+        };
+
+        ConcurrentActivePTW(
+            size_t n_arms,
+            size_t depth,
+            double log_precision = 0.0
+        );
+
+        ConcurrentActivePTW(const ConcurrentActivePTW &) = delete;
+        ConcurrentActivePTW &operator=(const ConcurrentActivePTW &) = delete;
+
+        // a handle for a new reader thread, drawing from its own generator
+        Reader reader(const rng_seed_t &seed) const;
+
+        // learn from a pull, then publish, from the writer thread only
+        void update(size_t arm, int reward);
+
+        // learn from n pulls in order, publishing once, from the writer
+        // thread only
+        void updateBatch(const pull_t *pulls, size_t n);
+
+        // the number of publications so far
+        uint64_t publications() const {
+            return m_published.load(std::memory_order_acquire);
+        }
+
+        // the model, which only the writer thread may read
+        const ActivePTW &model() const { return m_model; }
+
+    private:
+
+        // the published state. every field is atomic, so a reader racing
+        // with the writer sees torn data, which it then discards, rather
+        // than undefined behaviour
+        struct view_t {
+            std::atomic<uint64_t> seq;
+            std::unique_ptr<std::atomic<double>[]> posterior;
+            std::unique_ptr<std::atomic<uint64_t>[]> generations;
+
+            // [level][arm] beta parameters, valid while their stamp is the
+            // generation of their level
+            std::unique_ptr<std::atomic<double>[]> alphas;
+            std::unique_ptr<std::atomic<double>[]> betas;
+            std::unique_ptr<std::atomic<uint64_t>[]> stamps;
+        };
+
+        // apply a pull to the model, recording what it changes
+        void apply(size_t arm, int reward);
+
+        // write the changes since the inactive view was last written into
+        // it, then make it the current view
+        void publish();
+
+        ActivePTW m_model;
+        size_t m_arms;
+        size_t m_levels;
+
+        // the generation of each level, advanced as the level is reset
+        std::vector<uint64_t> m_generations;
+
+        // for each view, the [level][arm] slots changed since it was last
+        // written, as a list and as flags
+        std::vector<size_t> m_pending[2];
+        std::vector<bool> m_dirty[2];
+
+        // the views, of which the current is publications() % 2
+        view_t m_views[2];
+        std::atomic<uint64_t> m_published;
+};
+
+
+/* -------------------------------------------------------------------------- */
+
+
+#endif // __CONCURRENT_HPP__
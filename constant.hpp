@@ -3,6 +3,7 @@
 
 
 #include "bandits.hpp"
+#include "snapshot.hpp"
 
 #include <string>
 #include <cstddef>
@@ -28,6 +29,17 @@ class ConstantStrategy : public BanditStrategy {
         // name of the method, e.g. UCB
         std::string name() const override { return "Constant"; }
 
+        // there is no state beyond the action, which must match
+        void save(SnapshotWriter &out) const override {
+            out.str(name());
+            out.u64(m_action);
+        }
+
+        void restore(SnapshotReader &in) override {
+            in.expect(name());
+            in.expect(m_action, "constant action");
+        }
+
     private:
 
         size_t m_action;
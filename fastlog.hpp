@@ -0,0 +1,120 @@
+#ifndef __FASTLOG_HPP__
+#define __FASTLOG_HPP__
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// a table driven logAdd, accurate to within a given absolute error.
+//
+// log(x + y) = max + f(d), where f(d) = log(1 + exp(-d)) and d is the
+// non-negative difference of the logs. f is tabulated on [0, limit] and
+// linearly interpolated: since |f''| <= 1/4, a step h gives an error of at
+// most h^2/32, and beyond the limit f(d) <= exp(-d) is dropped entirely.
+// both are held to half the precision.
+class LogAddTable {
+
+    public:
+
+        explicit LogAddTable(double precision) :
+            m_precision(precision)
+        {
+            assert(precision > 0.0 && precision < 1.0);
+
+            double step = std::sqrt(16.0 * precision);
+            m_limit = std::log(2.0 / precision);
+            m_inv_step = 1.0 / step;
+
+            size_t n = static_cast<size_t>(std::ceil(m_limit * m_inv_step)) + 2;
+            m_table.resize(n);
+            for (size_t i = 0; i < n; i++) {
+                double d = static_cast<double>(i) * step;
+                m_table[i] = std::log1p(std::exp(-d));
+            }
+        }
+
+        // an approximation to log(exp(log_x) + exp(log_y))
+        double logAdd(double log_x, double log_y) const {
+            double hi = std::max(log_x, log_y);
+            double d = hi - std::min(log_x, log_y);
+
+            // also taken when either argument is -inf
+            if (!(d < m_limit)) return hi;
+
+            double u = d * m_inv_step;
+            size_t i = static_cast<size_t>(u);
+            double frac = u - static_cast<double>(i);
+
+            return hi + m_table[i] + frac * (m_table[i+1] - m_table[i]);
+        }
+
+        // the bound on the absolute error of logAdd
+        double precision() const { return m_precision; }
+
+        // a table for the given precision, shared by all callers and built
+        // at most once per precision, so is safe to use from many threads
+        static const LogAddTable &forPrecision(double precision) {
+            static std::mutex mutex;
+            static std::map<double, std::unique_ptr<LogAddTable>> tables;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            auto &table = tables[precision];
+            if (!table) table = std::make_unique<LogAddTable>(precision);
+
+            return *table;
+        }
+
+    private:
+
+        double m_precision;
+        double m_limit;
+        double m_inv_step;
+        std::vector<double> m_table;
+};
+
+
+/* -------------------------------------------------------------------------- */
+
+
+/* log(k/2) for a non-negative integer k. KT estimator parameters are always
+   a multiple of one half, so their logarithms are drawn from a shared table
+   of exact values, falling back to std::log beyond it. the table takes 1MB,
+   so is only built on first use, by a model using table driven logs. */
+inline double logHalfInteger(size_t k) {
+    constexpr size_t TableSize = 1 << 17;
+
+    static const std::vector<double> table = []() {
+        std::vector<double> t(TableSize);
+        for (size_t i = 0; i < TableSize; i++) {
+            t[i] = std::log(0.5 * static_cast<double>(i));
+        }
+        return t;
+    }();
+
+    return k < TableSize ? table[k] : std::log(0.5 * static_cast<double>(k));
+}
+
+
+/* log(a / total) for KT statistics a and total, each a multiple of one half,
+   as the difference of two table lookups. */
+inline double logKTRatio(double a, double total) {
+    size_t num = static_cast<size_t>(2.0 * a);
+    size_t den = static_cast<size_t>(2.0 * total);
+
+    return logHalfInteger(num) - logHalfInteger(den);
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+#endif // __FASTLOG_HPP__
@@ -0,0 +1,492 @@
+#ifndef __INDEX_HPP__
+#define __INDEX_HPP__
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <vector>
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// a tournament tree over the arms of a UCB style strategy, whose leaves hold
+// an upper bound on each arm's score, valid until the owner next rebuilds
+// it. the argmax is found by a best first search over the tree, which stops
+// once no unexamined subtree can beat the best exact score seen, so only the
+// few arms whose bounds are competitive have their scores evaluated.
+//
+// an arm's score is a function of its statistics, so the many arms sharing
+// the same statistics, such as those pulled once without reward, tie
+// exactly. arms are therefore grouped by statistics, and only the lowest
+// indexed arm of each group is kept in the tree, which is the only member
+// of the group that can be the argmax. the groups are found through an open
+// addressed hash table, and hold their members in a treap ordered by index,
+// all of it preallocated for one group per arm, so updates never allocate.
+//
+// for small catalogs, scoring every arm is cheaper than the bookkeeping, so
+// up to a given number of arms the bounds are ignored and argmax is a scan.
+class UpperBoundTree {
+
+    public:
+
+        // the statistics which determine an arm's score,
+        // e.g. its reward total and number of visits
+        typedef std::pair<double, double> stats_t;
+
+        // the bound of an arm whose score is unbounded
+        static constexpr double Infinity =
+            std::numeric_limits<double>::infinity();
+
+        // the number of arms up to which a UCB1 score is cheaper to scan
+        static constexpr size_t ScanArms = 128;
+
+        explicit UpperBoundTree(size_t n = 0, size_t scan_arms = ScanArms) :
+            m_scan_arms(scan_arms)
+        {
+            resize(n);
+        }
+
+        // reset to n arms, each with zero statistics and an unbounded score
+        void resize(size_t n) {
+            m_size = n;
+            m_leaves = 1;
+            while (m_leaves < n) m_leaves <<= 1;
+
+            m_tree.assign(2 * m_leaves, -Infinity);
+            m_stats.assign(n, stats_t(0.0, 0.0));
+
+            if (n == 0 || scanned()) return;
+
+            // at most one group per arm, at most half filling the table
+            size_t slots = 2;
+            while (slots < 2 * n) slots <<= 1;
+            m_slots.assign(slots, Nil);
+
+            m_groups.assign(n, group_t());
+            m_live.clear();
+            m_live.reserve(n);
+            m_free.clear();
+            m_free.reserve(n);
+            for (size_t k = n; k > 0; k--) m_free.push_back(k - 1);
+
+            m_group.assign(n, 0);
+            m_left.assign(n, Nil);
+            m_right.assign(n, Nil);
+
+            size_t id = findGroup(stats_t(0.0, 0.0));
+            group_t &g = m_groups[id];
+            for (size_t i = 0; i < n; i++) insert(g.root, i);
+            g.size = n;
+            g.leader = 0;
+            g.bound = Infinity;
+
+            m_tree[m_leaves] = Infinity;
+            for (size_t v = m_leaves - 1; v >= 1; v--) pull(v);
+        }
+
+        // the number of arms
+        size_t size() const { return m_size; }
+
+        // the bound on the score of arm i, as last set or rebuilt
+        double bound(size_t i) const {
+            if (scanned()) return Infinity;
+            return m_groups[m_group[i]].bound;
+        }
+
+        // record new statistics for arm i, together with an upper bound on
+        // the score of any arm with those statistics, in O(log n)
+        void set(size_t i, const stats_t &stats, double bound) {
+            assert(i < m_size);
+            if (scanned()) return;
+
+            // leave the old group, promoting the next member if i led it
+            size_t from = m_group[i];
+            group_t &old = m_groups[from];
+
+            erase(old.root, i);
+            old.size--;
+
+            if (old.leader == i) {
+                setLeaf(i, -Infinity);
+                if (old.size > 0) {
+                    old.leader = leftmost(old.root);
+                    setLeaf(old.leader, old.bound);
+                }
+            }
+            if (old.size == 0) dropGroup(from);
+
+            // join the new group, demoting its leader if i precedes it
+            size_t to = findGroup(stats);
+            group_t &g = m_groups[to];
+            if (g.size > 0 && g.leader > i) setLeaf(g.leader, -Infinity);
+
+            insert(g.root, i);
+            if (g.size == 0 || i < g.leader) g.leader = i;
+            g.size++;
+            g.bound = bound;
+            setLeaf(g.leader, bound);
+            m_stats[i] = stats;
+            m_group[i] = to;
+        }
+
+        // set the upper bound of every group to bound(i), where i is any
+        // member, in time linear in the number of groups
+        template <class BoundFn>
+        void rebuild(BoundFn bound) {
+            if (scanned()) return;
+
+            for (size_t id : m_live) {
+                group_t &g = m_groups[id];
+                g.bound = bound(g.leader);
+                m_tree[m_leaves + g.leader] = g.bound;
+            }
+            for (size_t v = m_leaves - 1; v >= 1; v--) pull(v);
+        }
+
+        // the lowest index arm maximising score(i), given that every arm's
+        // score is at most its upper bound
+        template <class ScoreFn>
+        size_t argmax(ScoreFn score) const {
+            double best = -Infinity;
+            size_t best_idx = 0;
+
+            if (scanned()) {
+                for (size_t i = 0; i < m_size; i++) {
+                    double s = score(i);
+                    if (s > best) {
+                        best = s;
+                        best_idx = i;
+                    }
+                }
+                return best_idx;
+            }
+
+            m_frontier.clear();
+            push(1, 0, m_leaves);
+
+            while (!m_frontier.empty()) {
+                std::pop_heap(m_frontier.begin(), m_frontier.end(), before);
+                node_t n = m_frontier.back();
+                m_frontier.pop_back();
+
+                // nothing left can beat the best, or tie it at a lower index
+                if (n.bound < best) break;
+                if (n.bound == best && n.first > best_idx) break;
+
+                if (n.node >= m_leaves) {
+                    double s = score(n.first);
+                    if (s > best || (s == best && n.first < best_idx)) {
+                        best = s;
+                        best_idx = n.first;
+                    }
+                } else {
+                    size_t half = n.width / 2;
+                    push(2 * n.node, n.first, half);
+                    push(2 * n.node + 1, n.first + half, half);
+                }
+            }
+
+            return best_idx;
+        }
+
+    private:
+
+        // the absent arm, group or table entry
+        static constexpr size_t Nil = std::numeric_limits<size_t>::max();
+
+        // the arms sharing some statistics, and the bound on their score,
+        // with the members held in a treap rooted at root
+        struct group_t {
+            stats_t stats;
+            double bound = -Infinity;
+            size_t root = Nil;
+            size_t leader = Nil;
+            size_t size = 0;
+            size_t live = 0;
+        };
+
+        // a subtree awaiting examination, covering arms [first, first+width)
+        struct node_t {
+            double bound;
+            size_t first;
+            size_t width;
+            size_t node;
+        };
+
+        // max heap order on bound, preferring lower indexed subtrees on ties
+        static bool before(const node_t &a, const node_t &b) {
+            if (a.bound != b.bound) return a.bound < b.bound;
+            return a.first > b.first;
+        }
+
+        bool scanned() const { return m_size <= m_scan_arms; }
+
+        void push(size_t node, size_t first, size_t width) const {
+            if (first >= m_size || m_tree[node] == -Infinity) return;
+
+            m_frontier.push_back({m_tree[node], first, width, node});
+            std::push_heap(m_frontier.begin(), m_frontier.end(), before);
+        }
+
+        void setLeaf(size_t i, double bound) {
+            size_t v = m_leaves + i;
+            m_tree[v] = bound;
+            for (v >>= 1; v >= 1; v >>= 1) pull(v);
+        }
+
+        void pull(size_t v) {
+            m_tree[v] = std::max(m_tree[2 * v], m_tree[2 * v + 1]);
+        }
+
+        // the table entry at which some statistics belong, treating -0.0
+        // and 0.0 alike as comparisons do
+        size_t home(const stats_t &stats) const {
+            uint64_t a, b;
+            double x = stats.first + 0.0, y = stats.second + 0.0;
+            std::memcpy(&a, &x, sizeof(a));
+            std::memcpy(&b, &y, sizeof(b));
+
+            uint64_t h = a * 0x9e3779b97f4a7c15ull ^ b;
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdull;
+            h ^= h >> 33;
+            return static_cast<size_t>(h) & (m_slots.size() - 1);
+        }
+
+        // the group with the given statistics, created empty if none exists
+        size_t findGroup(const stats_t &stats) {
+            size_t mask = m_slots.size() - 1;
+            size_t s = home(stats);
+            for (; m_slots[s] != Nil; s = (s + 1) & mask) {
+                if (m_groups[m_slots[s]].stats == stats) return m_slots[s];
+            }
+
+            assert(!m_free.empty());
+            size_t id = m_free.back();
+            m_free.pop_back();
+
+            group_t &g = m_groups[id];
+            g = group_t();
+            g.stats = stats;
+            g.live = m_live.size();
+            m_live.push_back(id);
+            m_slots[s] = id;
+            return id;
+        }
+
+        // remove an empty group, shifting back the table entries after it
+        // so that none is separated from its home by an empty entry
+        void dropGroup(size_t id) {
+            size_t mask = m_slots.size() - 1;
+            size_t s = home(m_groups[id].stats);
+            while (m_slots[s] != id) s = (s + 1) & mask;
+
+            size_t j = (s + 1) & mask;
+            for (; m_slots[j] != Nil; j = (j + 1) & mask) {
+                // an entry may fill s unless its home lies in (s, j]
+                size_t k = home(m_groups[m_slots[j]].stats);
+                bool moves = s <= j ? (k <= s || k > j) : (k <= s && k > j);
+                if (!moves) continue;
+                m_slots[s] = m_slots[j];
+                s = j;
+            }
+            m_slots[s] = Nil;
+
+            size_t last = m_live.back();
+            m_live[m_groups[id].live] = last;
+            m_groups[last].live = m_groups[id].live;
+            m_live.pop_back();
+            m_free.push_back(id);
+        }
+
+        // the heap priority of an arm in a treap, a fixed hash of its index
+        static uint64_t priority(size_t i) {
+            uint64_t h = static_cast<uint64_t>(i) + 0x9e3779b97f4a7c15ull;
+            h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+            h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+            return h ^ (h >> 31);
+        }
+
+        // split treap t into the arms below key and the rest
+        void split(size_t t, size_t key, size_t &lo, size_t &hi) {
+            if (t == Nil) {
+                lo = hi = Nil;
+            } else if (t < key) {
+                split(m_right[t], key, m_right[t], hi);
+                lo = t;
+            } else {
+                split(m_left[t], key, lo, m_left[t]);
+                hi = t;
+            }
+        }
+
+        // join treaps lo and hi, every arm of lo preceding every arm of hi
+        size_t merge(size_t lo, size_t hi) {
+            if (lo == Nil) return hi;
+            if (hi == Nil) return lo;
+
+            if (priority(lo) > priority(hi)) {
+                m_right[lo] = merge(m_right[lo], hi);
+                return lo;
+            }
+            m_left[hi] = merge(lo, m_left[hi]);
+            return hi;
+        }
+
+        void insert(size_t &root, size_t i) {
+            size_t lo, hi;
+            m_left[i] = m_right[i] = Nil;
+            split(root, i, lo, hi);
+            root = merge(merge(lo, i), hi);
+        }
+
+        void erase(size_t &root, size_t i) {
+            size_t lo, mid, hi;
+            split(root, i, lo, hi);
+            split(hi, i + 1, mid, hi);
+            assert(mid == i);
+            root = merge(lo, hi);
+        }
+
+        size_t leftmost(size_t t) const {
+            while (m_left[t] != Nil) t = m_left[t];
+            return t;
+        }
+
+        size_t m_scan_arms;
+        size_t m_size;
+        size_t m_leaves;
+
+        // the maximum bound of each subtree, with the root at 1 and the leaf
+        // of arm i at m_leaves + i, which is -inf unless i leads its group
+        std::vector<double> m_tree;
+
+        // the statistics of each arm, and the group they place it in
+        std::vector<stats_t> m_stats;
+        std::vector<size_t> m_group;
+
+        // every group, those in use, and those free to be reused
+        std::vector<group_t> m_groups;
+        std::vector<size_t> m_live;
+        std::vector<size_t> m_free;
+
+        // the group of each entry of the hash table, or Nil if empty
+        std::vector<size_t> m_slots;
+
+        // the children of each arm in its group's treap
+        std::vector<size_t> m_left;
+        std::vector<size_t> m_right;
+
+        // scratch space for the search, reused between calls
+        mutable std::vector<node_t> m_frontier;
+};
+
+
+/* -------------------------------------------------------------------------- */
+
+
+/* the time until which bounds on UCB style scores taken at time t are valid.
+   the horizon grows geometrically, so bounds are rebuilt O(log T) times over
+   T steps, but only slowly, as the looser the bounds the more arms remain
+   competitive with the best score. */
+inline double boundHorizon(double t) {
+    return t + std::floor(t / 64.0) + 1.0;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// a subset of {0, ..., n-1}, such as the unvisited arms, supporting updates
+// and selection of its k'th smallest member in O(log n) using a Fenwick tree
+class RankSet {
+
+    public:
+
+        // the full set if full, otherwise the empty set
+        RankSet(size_t n = 0, bool full = false) { reset(n, full); }
+
+        void reset(size_t n, bool full) {
+            m_member.assign(n, full);
+            m_count = full ? n : 0;
+
+            m_log = 1;
+            while ((static_cast<size_t>(1) << m_log) <= n) m_log++;
+
+            m_tree.assign(n + 1, 0);
+            if (!full) return;
+
+            for (size_t i = 1; i <= n; i++) {
+                m_tree[i] += 1;
+                size_t parent = i + lowbit(i);
+                if (parent <= n) m_tree[parent] += m_tree[i];
+            }
+        }
+
+        // the number of members
+        size_t size() const { return m_count; }
+
+        bool empty() const { return m_count == 0; }
+
+        bool contains(size_t i) const { return m_member[i]; }
+
+        void insert(size_t i) {
+            if (m_member[i]) return;
+            m_member[i] = true;
+            m_count++;
+            for (size_t j = i + 1; j < m_tree.size(); j += lowbit(j)) {
+                m_tree[j]++;
+            }
+        }
+
+        void erase(size_t i) {
+            if (!m_member[i]) return;
+            m_member[i] = false;
+            m_count--;
+            for (size_t j = i + 1; j < m_tree.size(); j += lowbit(j)) {
+                m_tree[j]--;
+            }
+        }
+
+        // the k'th smallest member, counting from 0
+        size_t select(size_t k) const {
+            assert(k < m_count);
+
+            // descend the implicit tree, skipping blocks of fewer members
+            size_t pos = 0;
+            size_t step = static_cast<size_t>(1) << m_log;
+            for (; step > 0; step >>= 1) {
+                size_t next = pos + step;
+                if (next < m_tree.size() && m_tree[next] <= k) {
+                    pos = next;
+                    k -= m_tree[next];
+                }
+            }
+
+            return pos;
+        }
+
+    private:
+
+        // the lowest set bit of i
+        static size_t lowbit(size_t i) { return i & (~i + 1); }
+
+        std::vector<bool> m_member;
+        size_t m_count;
+        size_t m_log;
+
+        // 1-based Fenwick tree of member counts
+        std::vector<size_t> m_tree;
+};
+
+
+/* -------------------------------------------------------------------------- */
+
+
+#endif // __INDEX_HPP__
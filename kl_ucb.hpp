@@ -3,6 +3,8 @@
 
 
 #include "bandits.hpp"
+#include "index.hpp"
+#include "rng.hpp"
 
 
 /* -------------------------------------------------------------------------- */
@@ -12,7 +14,7 @@ class KLUCBStrategy : public BanditStrategy {
 
     public:
 
-        KLUCBStrategy(unsigned int seed, size_t n_arms);
+        KLUCBStrategy(const rng_seed_t &seed, size_t n_arms);
 
         // implement the KL-UCB policy
         size_t getAction() override;
@@ -22,29 +24,62 @@ class KLUCBStrategy : public BanditStrategy {
 
         std::string name() const override { return "KL-UCB"; }
 
+        void save(SnapshotWriter &out) const override;
+
+        // restores the bounds and warm starts as they were, so the search
+        // and the iterative inversions are unchanged
+        void restore(SnapshotReader &in) override;
+
         // resets the mean/visit statistics
         void reset();
 
+        // the KL-UCB score of the last action, an optimistic
+        // estimate of the best arm's mean
+        double optimism() const { return m_optimism; }
+
     private:
 
-        // gives a vector of unvisited arms
-        std::vector<size_t> unvisitedArms() const;
+        // the log f(t) exploration term at time t
+        static double logF(double t);
+
+        // bound every arm's score until a new horizon
+        void rebuildBounds();
+
+        // an upper bound on an arm's score at every time up to the horizon
+        double bound(size_t arm) const;
 
-        // KL-UCB score of a given arm
-        double klUCB(size_t arm) const;
+        // KL-UCB score of a given arm, given the log f(t) exploration term
+        double klUCB(size_t arm, double log_ft) const;
 
-        // maximise bernoulli relative entropy d(p, q) <= ub w.r.t. q
-        double maxRelEntropy(double p, double ub) const;
+        // maximise bernoulli relative entropy d(p, q) <= ub w.r.t. q,
+        // starting the search from guess if it lies in (p, 1)
+        double maxRelEntropy(double p, double ub, double guess) const;
 
         // limited amount of randomness used in this implementation
         // so that the "play each arm once" step is done according
         // to a random permutation of the arm indices
-        mutable std::default_random_engine m_generator;
+        mutable RandomEngine m_generator;
 
         size_t m_arms;
         std::vector<double> m_arm_successes;
         std::vector<double> m_arm_visits;
         double m_visits;
+
+        // the index of each arm at its last evaluation, from which the next
+        // evaluation is warm started, or 0 if it has never been evaluated
+        std::vector<double> m_index;
+
+        // the arms not yet visited
+        RankSet m_unvisited;
+
+        // each arm's score at the horizon, which bounds its score at every
+        // earlier time, since log f(t) grows with time. the score costs an
+        // iterative inversion, so the tree is searched even for few arms
+        UpperBoundTree m_bounds;
+        double m_horizon;
+        double m_horizon_log_ft;
+
+        double m_optimism;
 };
 
 
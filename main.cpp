@@ -1,32 +1,46 @@
-// Copyright 2025 Google LLC
-//
-// Licensed under the Apache License, Version 2.0 (the "License");
-// you may not use this file except in compliance with the License.
-// You may obtain a copy of the License at
-//
-//    http://www.apache.org/licenses/LICENSE-2.0
-//
-// Unless required by applicable law or agreed to in writing, software
-// distributed under the License is distributed on an "AS IS" BASIS,
-// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
-// See the License for the specific language governing permissions and
-// limitations under the License.
-// ==============================================================================
-
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ==============================================================================
+
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include <algorithm>
 #include <iostream>
 #include <limits>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
+#include "bench.hpp"
 #include "common.hpp"
+#include "npy.hpp"
+#include "parallel.hpp"
+#include "profile.hpp"
+#include "replay.hpp"
+#include "rng.hpp"
+#include "snapshot.hpp"
+#include "stats.hpp"
+
+#include "batch.hpp"
 
 // bandit algorithms
 #include "bandits.hpp"
 #include "ts.hpp"
+#include "ts_static.hpp"
 #include "ucb.hpp"
 #include "kl_ucb.hpp"
 #include "sliding_ucb.hpp"
@@ -51,12 +65,74 @@ struct params_t {
     size_t       SWUCBWindow = CptRate > 0 ?
         size_t(1.0 / CptRate + 0.5) : std::numeric_limits<size_t>::max();
     std::string  CptSchedule = "Geometric";
+    double       MASTERConfidence = 0.0;  // 0 uses the analysis' constants
+    size_t       PTWDepth    = 0;  // 0 derives the depth from Trials
+    bool         PTWRolling  = false;
+    double       LogPrecision = 0.0;  // 0 uses the exact log arithmetic
+    RngKind      Rng         = RngKind::Xoshiro256pp;
+    size_t       Threads     = 1;
+    size_t       Batch       = 1;  // repeats simulated in lockstep
+    size_t       Delay       = 1;  // actions served per reward batch
+    size_t       PlotPoints  = 0;  // 0 plots every trial
+    std::string  PlotData;         // if set, plot data is written here
+    std::string  BenchBaseline;    // if set, bench mode compares against it
+    double       BenchTolerance = 1.25;
+    std::string  Bench       = "ptw";  // which benchmarks bench mode runs
+    std::vector<size_t> BenchArms = {2, 10, 100, 1000, 10000, 100000};
+    std::vector<size_t> BenchTrials = {1000, 100000};
+    double       BenchBudget = 1.0;  // seconds per agent or problem timing
+    bool         Profile     = false;  // text mode reports hot path costs
+    std::string  LoadSnapshot;     // if set, text mode resumes the agent
+    std::string  SaveSnapshot;     // if set, text mode saves the agent
+    std::string  SaveLog;          // if set, text mode logs its pulls
+    std::string  ReplayLog;        // the pull log replay mode evaluates on
 };
 
 // program options
 params_t Params;
 
 
+// parse a comma separated list of positive integers
+static std::vector<size_t> parseSizeList(const std::string &s) {
+    std::vector<size_t> values;
+
+    size_t first = 0;
+    while (first <= s.size()) {
+        size_t last = std::min(s.find(',', first), s.size());
+        std::string item = s.substr(first, last - first);
+
+        if (item.empty() || item.find_first_not_of("0123456789") !=
+            std::string::npos) {
+            die_with_error("lists need to be comma separated integers.");
+        }
+        values.push_back(std::stoull(item));
+        if (values.back() == 0) {
+            die_with_error("list items need to be positive.");
+        }
+
+        first = last + 1;
+    }
+
+    return values;
+}
+
+
+// the depth of the PTW models: PTWDepth if given, and otherwise the
+// shallowest whose horizon covers every trial. a model that does not roll
+// cannot process more pulls than its horizon, so a shallower PTWDepth is
+// an error
+static size_t ptwDepth() {
+    size_t shallowest = ActivePTW::depthForHorizon(Params.Trials);
+    if (Params.PTWDepth == 0) return shallowest;
+
+    if (!Params.PTWRolling && Params.PTWDepth < shallowest) {
+        die_with_error("PTWDepth needs to cover Trials unless PTWRolling=1.");
+    }
+
+    return Params.PTWDepth;
+}
+
+
 // process the command line options
 void processCmdLine(int argc, char *argv[]) {
     for (size_t i=1; i < argc; i++) {
@@ -87,6 +163,81 @@ void processCmdLine(int argc, char *argv[]) {
             if (Params.SWUCBWindow < 1) {
                 die_with_error("SWUCBWindow need to be positive.");
             }
+        } else if (lhs == "MASTERConfidence") {
+            Params.MASTERConfidence = std::stod(rhs);
+            if (Params.MASTERConfidence < 0.0) {
+                die_with_error("MASTERConfidence needs to be non-negative.");
+            }
+        } else if (lhs == "PTWDepth") {
+            Params.PTWDepth = std::stoi(rhs);
+            if (Params.PTWDepth > 62) {
+                die_with_error("PTWDepth needs to be at most 62.");
+            }
+        } else if (lhs == "LogPrecision") {
+            Params.LogPrecision = std::stod(rhs);
+            if (Params.LogPrecision < 0.0 || Params.LogPrecision > 0.1) {
+                die_with_error("LogPrecision needs to be in [0, 0.1].");
+            }
+        } else if (lhs == "Profile") {
+            Params.Profile = std::stoi(rhs) != 0;
+        } else if (lhs == "PTWRolling") {
+            Params.PTWRolling = std::stoi(rhs) != 0;
+        } else if (lhs == "PlotData") {
+            Params.PlotData = rhs;
+        } else if (lhs == "LoadSnapshot") {
+            Params.LoadSnapshot = rhs;
+        } else if (lhs == "SaveSnapshot") {
+            Params.SaveSnapshot = rhs;
+        } else if (lhs == "SaveLog") {
+            Params.SaveLog = rhs;
+        } else if (lhs == "ReplayLog") {
+            Params.ReplayLog = rhs;
+        } else if (lhs == "PlotPoints") {
+            Params.PlotPoints = std::stoi(rhs);
+        } else if (lhs == "BenchBaseline") {
+            Params.BenchBaseline = rhs;
+        } else if (lhs == "Bench") {
+            Params.Bench = rhs;
+            if (rhs != "ptw" && rhs != "agents" && rhs != "env" &&
+                rhs != "serve" && rhs != "all") {
+                die_with_error(
+                    "Bench needs to be one of ptw/agents/env/serve/all."
+                );
+            }
+        } else if (lhs == "BenchArms") {
+            Params.BenchArms = parseSizeList(rhs);
+            for (auto arms : Params.BenchArms) {
+                if (arms < 2) {
+                    die_with_error("BenchArms need to be at least 2.");
+                }
+            }
+        } else if (lhs == "BenchTrials") {
+            Params.BenchTrials = parseSizeList(rhs);
+        } else if (lhs == "BenchBudget") {
+            Params.BenchBudget = std::stod(rhs);
+            if (Params.BenchBudget <= 0.0) {
+                die_with_error("BenchBudget needs to be positive.");
+            }
+        } else if (lhs == "BenchTolerance") {
+            Params.BenchTolerance = std::stod(rhs);
+            if (Params.BenchTolerance < 1.0) {
+                die_with_error("BenchTolerance needs to be at least 1.0.");
+            }
+        } else if (lhs == "Delay") {
+            Params.Delay = std::stoi(rhs);
+            if (Params.Delay < 1) {
+                die_with_error("Delay needs to be positive.");
+            }
+        } else if (lhs == "Batch") {
+            Params.Batch = std::stoi(rhs);
+            if (Params.Batch < 1) {
+                die_with_error("Batch needs to be positive.");
+            }
+        } else if (lhs == "Threads") {
+            Params.Threads = std::stoi(rhs);
+            if (Params.Threads < 1) {
+                die_with_error("Threads need to be positive.");
+            }
         } else if (lhs == "Arms") {
             Params.Arms = std::stoi(rhs);
             if (Params.Arms < 2) {
@@ -94,12 +245,19 @@ void processCmdLine(int argc, char *argv[]) {
             }
         } else if (lhs == "Agent") {
             Params.Agent = rhs;
+        } else if (lhs == "Rng") {
+            if (!parseRngKind(rhs, Params.Rng)) {
+                die_with_error("Rng needs to be one of xoshiro/pcg.");
+            }
         } else if (lhs == "CptSchedule") {
             Params.CptSchedule = rhs;
         } else if (lhs == "Mode") {
             Params.Mode = rhs;
-            if (rhs != "text" && rhs != "plot") {
-                die_with_error("Mode needs to be one of text/gui/plot.");
+            if (rhs != "text" && rhs != "plot" && rhs != "bench" &&
+                rhs != "replay") {
+                die_with_error(
+                    "Mode needs to be one of text/plot/bench/replay."
+                );
             }
         } else if (lhs == "CptRate") {
             Params.CptRate = std::stod(rhs);
@@ -110,6 +268,9 @@ void processCmdLine(int argc, char *argv[]) {
             die_with_error("unrecognised arg.");
         }
     }
+
+    // the options may come in any order, so are checked together last
+    ptwDepth();
 }
 
 
@@ -132,13 +293,21 @@ static void showSummary(const StochasticBanditProblem &bp) {
 /* -------------------------------------------------------------------------- */
 
 
-// initialise a bandit algorithm from a string
-static std::unique_ptr<BanditStrategy> createBanditAlgorithm() {
-    auto name = Params.Agent;
-    auto seed = Params.AgentSeed;
+// initialise a bandit algorithm from a string, whose randomness is drawn
+// from the given stream of the generator seeded by AgentSeed
+static std::unique_ptr<BanditStrategy> createBanditAlgorithm(
+    const std::string &name,
+    uint64_t stream = 0
+) {
+    auto seed = rng_seed_t(Params.AgentSeed, stream, Params.Rng);
     auto arms = Params.Arms;
     auto window = Params.SWUCBWindow;
 
+    auto depth = ptwDepth();
+    auto rolling = Params.PTWRolling;
+    auto precision = Params.LogPrecision;
+    auto scale = Params.MASTERConfidence;
+
     if (name == "UCB") {
         return std::make_unique<UCBStrategy>(seed, arms);
     } else if (name == "KLUCB") {
@@ -146,11 +315,28 @@ static std::unique_ptr<BanditStrategy> createBanditAlgorithm() {
     } else if (name == "SWUCB") {
         return std::make_unique<SlidingUCBStrategy>(seed, arms, window);
     } else if (name == "ActivePTW") {
-        return std::make_unique<ActivePTWBanditStrategy>(seed, arms);
+        // prefer a specialisation compiled for this shape, if one exists
+        if (!rolling && precision == 0.0) {
+            auto agent = createStaticActivePTWStrategy(seed, arms, depth);
+            if (agent) return agent;
+        }
+        return std::make_unique<ActivePTWBanditStrategy>(
+            seed, arms, depth, rolling, precision
+        );
     } else if (name == "ParanoidPTW") {
-        return std::make_unique<ParanoidPTWBanditStrategy>(seed, arms);
+        return std::make_unique<ParanoidPTWBanditStrategy>(
+            seed, arms, depth, rolling, precision
+        );
     } else if (name == "MALG") {
         return std::make_unique<MalgUCB>(seed, arms, 20);
+    } else if (name == "MALG-KLUCB") {
+        return std::make_unique<MalgKLUCB>(seed, arms, 20, name);
+    } else if (name == "MASTER") {
+        return std::make_unique<MasterUCB>(seed, arms, Params.Trials, scale);
+    } else if (name == "MASTER-KLUCB") {
+        return std::make_unique<MasterKLUCB>(
+            seed, arms, Params.Trials, scale, name
+        );
     } else if (name == "TS") {
         return std::make_unique<ThompsonSamplingStrategy>(seed, arms);
     } else if (name == "Constant") {
@@ -165,11 +351,52 @@ static std::unique_ptr<BanditStrategy> createBanditAlgorithm() {
 }
 
 
+// create a batch of replicas of a bandit algorithm, where replica r behaves
+// exactly as createBanditAlgorithm(name, first_stream + r) would
+static std::unique_ptr<BatchBanditStrategy> createBatchAlgorithm(
+    const std::string &name,
+    uint64_t first_stream,
+    size_t replicas
+) {
+    std::vector<rng_seed_t> seeds;
+    for (size_t r = 0; r < replicas; r++) {
+        seeds.emplace_back(Params.AgentSeed, first_stream + r, Params.Rng);
+    }
+
+    auto arms = Params.Arms;
+    auto depth = ptwDepth();
+
+    if (name == "TS") {
+        return std::make_unique<ThompsonSamplingBatch>(seeds, arms);
+    } else if (name == "ActivePTW" && !Params.PTWRolling &&
+               Params.LogPrecision == 0.0) {
+        // the batched model only implements the exact log arithmetic
+        return std::make_unique<ActivePTWBatchStrategy>(seeds, arms, depth);
+    }
+
+    // otherwise fall back to running the scalar strategy for each replica
+    std::vector<std::unique_ptr<BanditStrategy>> agents;
+    for (size_t r = 0; r < replicas; r++) {
+        agents.push_back(createBanditAlgorithm(name, first_stream + r));
+    }
+
+    return std::make_unique<StrategyBatch>(std::move(agents));
+}
+
+
 /* -------------------------------------------------------------------------- */
 
 
-// create the bandit problem with associated latent change-point schedule
-static std::unique_ptr<StochasticBanditProblem> createBanditProblem() {
+// the environment and its change-point schedule use separate streams
+static rng_seed_t envSeed() {
+    return rng_seed_t(Params.EnvSeed, 0, Params.Rng);
+}
+
+
+// create the latent change-point schedule
+static std::unique_ptr<ChangeSchedule> createChangeSchedule() {
+    auto schedule_seed = rng_seed_t(Params.EnvSeed, 1, Params.Rng);
+
     if (Params.CptSchedule == "Nasty") {
         arm_initialisation_t theta1(Params.Arms, 0.1);
         theta1[0] = 0.2;
@@ -177,25 +404,17 @@ static std::unique_ptr<StochasticBanditProblem> createBanditProblem() {
         theta2[0] = 0.2;
         theta2[1] = 0.8;
 
-        return std::make_unique<StochasticBanditProblem>(
-            Params.Arms,
-            Params.EnvSeed,
-            std::make_unique<TwoPhaseChangeSchedule>(
-                Params.Trials,
-                theta1,
-                theta2
-            )
+        return std::make_unique<TwoPhaseChangeSchedule>(
+            Params.Trials,
+            theta1,
+            theta2
         );
 
     } else if (Params.CptSchedule == "Geometric") {
-        return std::make_unique<StochasticBanditProblem>(
-            Params.Arms,
-            Params.EnvSeed,
-            std::make_unique<GeometricAbruptChangeSchedule>(
-                Params.CptRate,
-                Params.Trials,
-                Params.EnvSeed+10007
-            )
+        return std::make_unique<GeometricAbruptChangeSchedule>(
+            Params.CptRate,
+            Params.Trials,
+            schedule_seed
         );
     }
 
@@ -204,6 +423,16 @@ static std::unique_ptr<StochasticBanditProblem> createBanditProblem() {
 }
 
 
+// create the bandit problem with associated latent change-point schedule
+static std::unique_ptr<StochasticBanditProblem> createBanditProblem() {
+    return std::make_unique<StochasticBanditProblem>(
+        Params.Arms,
+        envSeed(),
+        createChangeSchedule()
+    );
+}
+
+
 /* -------------------------------------------------------------------------  */
 
 
@@ -220,137 +449,190 @@ static int plotMode() {
         "ParanoidPTW"
     };
 
-    std::vector<std::vector<std::vector<double>>> regrets;
-    std::vector<size_t> cpts;
-    auto original_agent_seed = Params.AgentSeed;
-
-    for (size_t i=0; i < agents.size(); i++) {
-        regrets.push_back(std::vector<std::vector<double>>());
-
-        for (size_t j=0; j < Params.PlotRepeats; j++) {
-            cpts.clear();
-
-            regrets.back().push_back(std::vector<double>());
+    // the regret is recorded at times 1, 1+stride, 1+2*stride, ...
+    size_t stride = 1;
+    if (Params.PlotPoints > 0) {
+        stride = (Params.Trials + Params.PlotPoints - 1) / Params.PlotPoints;
+    }
+    size_t points = (Params.Trials + stride - 1) / stride;
 
-            // create the bandit environment
-            auto bp = createBanditProblem();
+    // the regret statistics of each agent are accumulated online. curves
+    // are folded in strictly in repeat order, so that results are identical
+    // for any number of threads; early finishers wait in pending meanwhile
+    std::vector<RunningStats> regrets(agents.size(), RunningStats(points));
+    std::vector<std::map<size_t, std::vector<double>>> pending(agents.size());
+    std::vector<size_t> next_repeat(agents.size(), 0);
+    std::mutex regrets_mutex;
 
-            // create the bandit
-            Params.Agent = agents[i];
-            Params.AgentSeed = original_agent_seed + j;
-            auto agent = createBanditAlgorithm();
+    std::vector<size_t> cpts;
 
-            // agent <-> environment loop
-            for (size_t t = 0; t < Params.Trials; t++) {
-                if (bp->changepoint())
-                    cpts.push_back(t+1);
+    // every (agent, batch of repeats) pair is an independent job, whose
+    // randomness depends only on the repeats, so results do not depend on
+    // scheduling or on the batch size
+    size_t batches = (Params.PlotRepeats + Params.Batch - 1) / Params.Batch;
+    size_t jobs = agents.size() * batches;
+
+    // every repeat faces the same environment, so its trajectory is drawn
+    // once and replayed to every job, giving paired regret curves
+    EnvironmentTrace trace(
+        Params.Arms, envSeed(), createChangeSchedule(), Params.Trials
+    );
+
+    parallelFor(jobs, Params.Threads, [&](size_t job) {
+        size_t i = job / batches;
+        size_t first = (job % batches) * Params.Batch;
+        size_t n = std::min(Params.Batch, Params.PlotRepeats - first);
+
+        // create the bandit environments, one per repeat
+        BanditProblemBatch bp(trace, n);
+
+        // create the bandits, each repeat using its own stream
+        auto agent = createBatchAlgorithm(agents[i], first, n);
+
+        std::vector<std::vector<double>> regret_curves(n);
+        for (auto &curve : regret_curves) curve.reserve(points);
+
+        std::vector<size_t> arms(n);
+        std::vector<int> rewards(n);
+
+        // agent <-> environment loop
+        for (size_t t = 0; t < Params.Trials; t++) {
+            // the change-points are the same for every job
+            if (job == 0 && bp.changepoint())
+                cpts.push_back(t+1);
+
+            agent->getActions(arms.data());
+            bp.pull(arms.data(), rewards.data());
+            agent->update(arms.data(), rewards.data());
+
+            if (t % stride == 0) {
+                for (size_t r = 0; r < n; r++) {
+                    regret_curves[r].push_back(bp.regret(r));
+                }
+            }
+        }
 
-                size_t arm = agent->getAction();
-                auto r = bp->pull(arm);
-                agent->update(arm, r);
+        std::lock_guard<std::mutex> lock(regrets_mutex);
+        for (size_t r = 0; r < n; r++) {
+            pending[i].emplace(first + r, std::move(regret_curves[r]));
+        }
 
-                double regret = bp->bestHindsightExpectedReturn();
-                regret -= bp->cummulativeReward();
-                regrets[i][j].push_back(regret);
-            }
+        auto it = pending[i].find(next_repeat[i]);
+        while (it != pending[i].end()) {
+            regrets[i].add(it->second);
+            pending[i].erase(it);
+            it = pending[i].find(++next_repeat[i]);
         }
-    }
+    });
 
     // write a newline to std::cerr for the progress bar
     std::cerr << std::endl;
 
     // now generate python code for the plot
-    std::cout << "import matplotlib.pyplot as plt" << std::endl;
-    std::cout << "import numpy as np" << std::endl;
+    std::cout << "import matplotlib.pyplot as plt" << '\n';
+    std::cout << "import numpy as np" << '\n';
 
     // make font size larger
-    std::cout << "plt.rcParams.update({'font.size': 50})" << std::endl;
+    std::cout << "plt.rcParams.update({'font.size': 50})" << '\n';
 
-    // write x-axis
-    std::cout << "x=np.arange(1," << (Params.Trials+1) << ")" << std::endl;
+    if (Params.PlotData.empty()) {
+        // write x-axis
+        std::cout << "x=np.arange(1," << (Params.Trials+1);
+        std::cout << "," << stride << ")" << '\n';
 
-    // compute mean
-    std::vector<std::vector<double>> means;
-    for (size_t i=0; i < agents.size(); i++) {
-        means.push_back(std::vector<double>());
+        // write datapoints, with 95% confidence intervals
+        for (size_t i=0; i < agents.size(); i++) {
+            const auto &rs = regrets[i];
 
-        for (size_t t=1; t <= Params.Trials; t++) {
-            double total = 0.0;
-            for (size_t j=0; j < Params.PlotRepeats; j++) {
-                total += regrets[i][j][t-1];
+            std::cout << "y" << i << "= np.asarray([";
+            for (size_t k=0; k < points; k++) {
+                std::cout << rs.mean(k) << ", " << '\n';
             }
-            means.back().push_back(total / Params.PlotRepeats);
-        }
-    }
+            std::cout << "])" << '\n';
 
-    // compute CI
-    std::vector<std::vector<double>> cis;
-    for (size_t i=0; i < agents.size(); i++) {
-        cis.push_back(std::vector<double>());
+            std::cout << "y" << i << "u= np.asarray([";
+            for (size_t k=0; k < points; k++) {
+                std::cout << (rs.mean(k) + rs.confidence(k)) << ", " << '\n';
+            }
+            std::cout << "])" << '\n';
 
-        for (size_t t=1; t <= Params.Trials; t++) {
-            double total = 0.0;
-            for (size_t j=0; j < Params.PlotRepeats; j++) {
-                total += std::pow(regrets[i][j][t-1] - means[i][j], 2.0);;
+            std::cout << "y" << i << "b= np.asarray([";
+            for (size_t k=0; k < points; k++) {
+                std::cout << (rs.mean(k) - rs.confidence(k)) << ", " << '\n';
             }
-            double repeats = static_cast<double>(Params.PlotRepeats);
-            double var = total / (repeats-1.0);
-            double stddev   = std::sqrt(var);
-            double stderr = stddev / std::sqrt(repeats);
-            cis.back().push_back(1.96*stderr);
+            std::cout << "])" << '\n';
         }
-    }
 
-    // write datapoints
-    for (size_t i=0; i < agents.size(); i++) {
-        std::cout << "y" << i << "= np.asarray([";
-        for (size_t t=1; t <= Params.Trials; t++) {
-            std::cout << means[i][t-1] << ", " << std::endl;
+        for (size_t i=0; i < agents.size(); i++) {
+            std::cout << "plt.plot(x, y";
+            std::cout << i;
+            std::cout << ", label='" << agents[i] << "')" << '\n';
+
+            std::cout << "plt.fill_between(x, y";
+            std::cout << i << "b, y" << i << "u,";
+            std::cout << " alpha=.15)" << '\n';
         }
-        std::cout << "])" << std::endl;
+    } else {
+        // write a matrix whose first row is the x-axis, followed by
+        // the mean, upper and lower 95% confidence bounds of each agent
+        size_t rows = 1 + 3 * agents.size();
+        std::vector<double> table(rows * points);
+
+        for (size_t k=0; k < points; k++) {
+            table[k] = static_cast<double>(1 + k * stride);
+        }
+
+        for (size_t i=0; i < agents.size(); i++) {
+            const auto &rs = regrets[i];
+            double *mean = &table[(1 + 3 * i) * points];
+            double *upper = mean + points;
+            double *lower = upper + points;
 
-        std::cout << "y" << i << "u= np.asarray([";
-        for (size_t t=1; t <= Params.Trials; t++) {
-            std::cout << (means[i][t-1]+cis[i][t-1]) << ", " << std::endl;
+            for (size_t k=0; k < points; k++) {
+                mean[k] = rs.mean(k);
+                upper[k] = rs.mean(k) + rs.confidence(k);
+                lower[k] = rs.mean(k) - rs.confidence(k);
+            }
         }
-        std::cout << "])" << std::endl;
 
-        std::cout << "y" << i << "b= np.asarray([";
-        for (size_t t=1; t <= Params.Trials; t++) {
-            std::cout << (means[i][t-1]-cis[i][t-1]) << ", " << std::endl;
+        if (!writeNpy(Params.PlotData, table, rows, points)) {
+            die_with_error("could not write PlotData file.");
         }
-        std::cout << "])" << std::endl;
-    }
 
-    for (size_t i=0; i < agents.size(); i++) {
-        std::cout << "plt.plot(x, y";
-        std::cout << i;
-        std::cout << ", label='" << agents[i] << "')" << std::endl;
+        // load the data as a python raw string literal
+        std::cout << "d=np.load(r'''" << Params.PlotData << "''')" << '\n';
+        std::cout << "x=d[0]" << '\n';
+
+        for (size_t i=0; i < agents.size(); i++) {
+            size_t row = 1 + 3 * i;
 
-        std::cout << "plt.fill_between(x, y";
-        std::cout << i << "b, y" << i << "u,";
-        std::cout << " alpha=.15)" << std::endl;
+            std::cout << "plt.plot(x, d[" << row << "]";
+            std::cout << ", label='" << agents[i] << "')" << '\n';
+
+            std::cout << "plt.fill_between(x, d[" << (row + 2) << "], ";
+            std::cout << "d[" << (row + 1) << "], alpha=.15)" << '\n';
+        }
     }
 
     // write labels
-    std::cout << "plt.plot()" << std::endl;
-    std::cout << "plt.xlabel('Time')" << std::endl;
-    std::cout << "plt.ylabel('Regret')" << std::endl;
+    std::cout << "plt.plot()" << '\n';
+    std::cout << "plt.xlabel('Time')" << '\n';
+    std::cout << "plt.ylabel('Regret')" << '\n';
     std::cout << "plt.title('Regret vs Time ";
     std::cout << "[Actions=" << Params.Arms;
     if (Params.CptSchedule != "Nasty")
         std::cout << ", " << "CptRate=" << Params.CptRate;
     std::cout << "]";
-    std::cout << "')" << std::endl;
-    std::cout << "plt.legend()" << std::endl;
+    std::cout << "')" << '\n';
+    std::cout << "plt.legend()" << '\n';
 
     // write changepoints
     for (auto &e : cpts) {
         std::cout << "plt.axvline(x=" << e;
-        std::cout << ", dashes=[0.1,0.5])" << std::endl;
+        std::cout << ", dashes=[0.1,0.5])" << '\n';
     }
 
-    std::cout << "plt.show()" << std::endl;
+    std::cout << "plt.show()" << '\n';
 
     return 0;
 }
@@ -365,16 +647,190 @@ static int textMode() {
     auto bp = createBanditProblem();
 
     // create the bandit
-    auto agent = createBanditAlgorithm();
+    auto agent = createBanditAlgorithm(Params.Agent);
+
+    // resume the agent from the state saved by an earlier run
+    if (!Params.LoadSnapshot.empty()) {
+        MappedFile file(Params.LoadSnapshot);
+        SnapshotReader in(file.data(), file.size());
+        agent->restore(in);
+
+        if (!in.done()) die_with_error("LoadSnapshot file has trailing data.");
+    }
+
+    std::vector<size_t> arms(Params.Delay);
+    std::vector<pull_t> pulls(Params.Delay);
+
+    // only consulted when profiling, so costs a branch per call otherwise
+    std::unique_ptr<Profiler> profiler;
+    if (Params.Profile) profiler = std::make_unique<Profiler>();
 
-    // agent <-> environment loop
-    for (size_t t = 0; t < Params.Trials; t++) {
-        size_t arm = agent->getAction();
-        auto r = bp->pull(arm);
-        agent->update(arm, r);
+    std::unique_ptr<PullLogWriter> log;
+    if (!Params.SaveLog.empty()) {
+        log = std::make_unique<PullLogWriter>(Params.SaveLog, Params.Arms);
+    }
+
+    // agent <-> environment loop, where the agent chooses Delay actions
+    // before receiving any of their rewards
+    for (size_t t = 0; t < Params.Trials; t += Params.Delay) {
+        size_t n = std::min(Params.Delay, Params.Trials - t);
+
+        if (profiler) profiler->beginActions();
+        agent->getActions(n, arms.data());
+        if (profiler) profiler->endActions(n, *agent);
+
+        for (size_t i = 0; i < n; i++) pulls[i].arm = arms[i];
+        bp->pullMany(pulls.data(), n);
+        if (log) log->append(pulls.data(), n);
+
+        if (profiler) profiler->beginUpdates();
+        agent->updateBatch(pulls.data(), n);
+        if (profiler) profiler->endUpdates(n, *agent);
     }
 
     showSummary(*bp);
+    if (profiler) profiler->report(std::cout);
+
+    if (log && !log->close()) die_with_error("could not write SaveLog file.");
+
+    if (!Params.SaveSnapshot.empty()) {
+        SnapshotWriter out;
+        agent->save(out);
+
+        if (!out.writeFile(Params.SaveSnapshot)) {
+            die_with_error("could not write SaveSnapshot file.");
+        }
+    }
+
+    return 0;
+}
+
+
+/* -------------------------------------------------------------------------  */
+
+
+/* time every agent, and the environment under the chosen change-point
+   schedule, on each combination of BenchArms and BenchTrials. each point
+   is configured exactly as text mode would be with those Arms and Trials. */
+static void benchSweep(std::vector<bench_result_t> &results) {
+    const std::vector<std::string> agents = {
+        "UCB",
+        "KLUCB",
+        "SWUCB",
+        "ActivePTW",
+        "ParanoidPTW",
+        "MALG",
+        "MALG-KLUCB",
+        "MASTER",
+        "MASTER-KLUCB",
+        "TS",
+        "Constant",
+        "Uniform"
+    };
+
+    bool bench_agents = Params.Bench == "agents" || Params.Bench == "all";
+    bool bench_env = Params.Bench == "env" || Params.Bench == "all";
+
+    params_t saved = Params;
+
+    for (auto arms : saved.BenchArms) {
+        for (auto trials : saved.BenchTrials) {
+            Params.Arms = arms;
+            Params.Trials = trials;
+
+            auto suffix = "_a" + std::to_string(arms) +
+                "_t" + std::to_string(trials);
+
+            for (size_t i = 0; bench_agents && i < agents.size(); i++) {
+                auto agent = createBanditAlgorithm(agents[i]);
+                double ns = benchAgent(*agent, arms, trials, saved.BenchBudget);
+                results.push_back({"agent_" + agents[i] + suffix, ns});
+            }
+
+            if (bench_env) {
+                auto bp = createBanditProblem();
+                double ns = benchProblem(*bp, trials, Params.BenchBudget);
+                results.push_back({"env_" + Params.CptSchedule + suffix, ns});
+            }
+        }
+    }
+
+    Params = saved;
+}
+
+
+/* time concurrent serving on each of BenchArms, with 1, 2, 4, ... reader
+   threads up to Threads, alongside the writer thread. */
+static void benchServe(std::vector<bench_result_t> &results) {
+    if (Params.Bench != "serve" && Params.Bench != "all") return;
+
+    for (auto arms : Params.BenchArms) {
+        for (size_t readers = 1; ; readers *= 2) {
+            readers = std::min(readers, Params.Threads);
+
+            double ns = benchServing(arms, readers, Params.BenchBudget);
+            results.push_back({
+                "serve_a" + std::to_string(arms) +
+                    "_r" + std::to_string(readers),
+                ns
+            });
+
+            if (readers == Params.Threads) break;
+        }
+    }
+}
+
+
+/* time the hot paths, optionally failing if any is slower than a baseline
+   previously written by this mode. */
+static int benchMode() {
+    std::vector<bench_result_t> results;
+
+    if (Params.Bench == "ptw" || Params.Bench == "all") results = benchPTW();
+    benchSweep(results);
+    benchServe(results);
+
+    writeBenchResults(std::cout, results);
+
+    if (Params.BenchBaseline.empty()) return 0;
+
+    std::vector<bench_result_t> baseline;
+    if (!readBenchResults(Params.BenchBaseline, baseline)) {
+        die_with_error("could not read BenchBaseline file.");
+    }
+
+    return countRegressions(results, baseline, Params.BenchTolerance) ? 1 : 0;
+}
+
+
+/* -------------------------------------------------------------------------  */
+
+
+/* evaluate the agent offline on a logged stream of pulls. the agent is
+   configured as text mode would be, over the log's arms and a horizon of
+   its every pull. */
+static int replayMode() {
+    if (Params.ReplayLog.empty()) {
+        die_with_error("replay mode needs a ReplayLog file.");
+    }
+
+    PullLog log(Params.ReplayLog);
+    Params.Arms = log.arms();
+    Params.Trials = static_cast<size_t>(std::max<uint64_t>(log.size(), 1));
+
+    auto agent = createBanditAlgorithm(Params.Agent);
+    auto result = replayPullLog(*agent, log);
+
+    double accepted = static_cast<double>(result.accepted);
+
+    std::cout << result.pulls << " logged pulls replayed." << std::endl;
+    std::cout << "Accepted: " << result.accepted << std::endl;
+    std::cout << "Total Reward: " << result.reward << std::endl;
+    std::cout << "Avg Reward: "
+        << (result.accepted > 0 ? result.reward / accepted : 0.0)
+        << std::endl;
+    std::cout << "Pulls per second: "
+        << static_cast<double>(result.pulls) / result.seconds << std::endl;
 
     return 0;
 }
@@ -391,6 +847,10 @@ int main(int argc, char* argv[]) {
         return textMode();
     } else if (Params.Mode == "plot") {
         return plotMode();
+    } else if (Params.Mode == "bench") {
+        return benchMode();
+    } else if (Params.Mode == "replay") {
+        return replayMode();
     }
 
     return 0;
@@ -1,51 +1,65 @@
 #ifndef __MASTER_HPP__
 #define __MASTER_HPP__
 
+#include <cassert>
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <algorithm>
 #include <memory>
-#include <random>
 #include <string>
 #include <vector>
 
 #include "bandits.hpp"
+#include "common.hpp"
+#include "kl_ucb.hpp"
+#include "rng.hpp"
+#include "snapshot.hpp"
 #include "ucb.hpp"
 
 
 /* -------------------------------------------------------------------------- */
 
 
-// An implementation of the MASTER and MALG meta-algorithms with UCB1.
+// An implementation of the MASTER and MALG meta-algorithms.
 //  See: https://arxiv.org/pdf/2102.05406.pdf for algorithm details.
 
 
+// the index of the lowest set bit of a non-zero mask
+size_t lowestSetBit(uint64_t mask);
+
+
 /* -------------------------------------------------------------------------- */
 
 
-class MalgUCB : public BanditStrategy {
+// MALG over any base learner constructible from a seed and a number of arms,
+// and restartable in place by reset(), such as UCBStrategy or KLUCBStrategy.
+//
+// an instance at level m runs for 2^m steps from a multiple of 2^m, so only
+// the levels up to the number of trailing zero bits of the elapsed time can
+// start or stop at any step. the active, i.e. shortest live, instance is the
+// lowest set bit of a mask of live levels, cached until then.
+template<class Base>
+class MalgStrategy : public BanditStrategy {
 
     struct instance_t {
 
-        instance_t(
-            unsigned int seed, size_t n_arms,
-            size_t start, size_t end)
-        :
-            alg(seed, n_arms),
-            s(start),
-            e(end)
+        instance_t(const rng_seed_t &seed, size_t n_arms) :
+            alg(seed, n_arms)
         {
         }
 
-        // segment length
-        size_t length() const { return e - s + 1; }
-
-        UCBStrategy alg;   // alg instance
-        size_t s;          // alg start time
-        size_t e;          // alg end time
+        Base alg;          // alg instance
     };
 
     public:
 
-        MalgUCB(unsigned int seed, size_t n_arms, size_t depth);
+        MalgStrategy(
+            const rng_seed_t &seed,
+            size_t n_arms,
+            size_t depth,
+            const std::string &name = "MALG"
+        );
 
         // get the action from MALG
         size_t getAction() override;
@@ -55,34 +69,261 @@ class MalgUCB : public BanditStrategy {
         void update(size_t arm, int reward) override;
 
         // name of the method
-        std::string name() const override { return "MALG"; }
+        std::string name() const override { return m_name; }
 
-    private:
+        // the record holds the schedule and the seed of instances yet to be
+        // created, followed by the record of each instance created so far,
+        // as a reset instance keeps its generator
+        void save(SnapshotWriter &out) const override;
+
+        void restore(SnapshotReader &in) override;
+
+        // start a fresh schedule over 2^depth steps, reusing the instances
+        void restart(size_t depth);
 
-        // the average regret bound used to schedule UCB instances
+        // the instance that chose the last action
+        const Base &activeLearner() const { return m_instances[m_active]->alg; }
+
+        // bit m is set if a level m instance was live at the last action
+        uint64_t liveLevels() const { return m_live; }
+
+        // the average regret bound used to schedule base instances
         double rho(double t) const;
 
-        // get the index to the active instance
-        size_t activeInstance() const;
+    private:
 
-        mutable std::default_random_engine m_generator;
-        size_t m_seed;
+        // start or stop the instances scheduled at the current time
+        void schedule();
+
+        mutable RandomEngine m_generator;
+        rng_seed_t m_seed;
         size_t m_arms;
         size_t m_n;
         size_t m_tau;
+        std::string m_name;
+
+        // the probability of starting an instance at each level
+        std::vector<double> m_thresholds;
 
         std::vector<std::unique_ptr<instance_t>> m_instances;
+
+        // bit m is set if the level m instance is live at time m_tau, and
+        // the time up to which the schedule has been applied
+        uint64_t m_live;
+        size_t m_scheduled;
+
+        // the index to the active instance
+        size_t m_active;
 };
 
 
+// MALG over the UCB1 and KL-UCB base learners
+typedef MalgStrategy<UCBStrategy> MalgUCB;
+typedef MalgStrategy<KLUCBStrategy> MalgKLUCB;
+
+
+/* -------------------------------------------------------------------------- */
+
+
+template<class Base>
+MalgStrategy<Base>::MalgStrategy(
+    const rng_seed_t &seed,
+    size_t n_arms,
+    size_t depth,
+    const std::string &name
+) :
+    m_generator(seed),
+    m_seed(seed),
+    m_arms(n_arms),
+    m_n(depth),
+    m_tau(1),
+    m_name(name),
+    m_live(0),
+    m_scheduled(0),
+    m_active(0)
+{
+    restart(depth);
+}
+
+
+template<class Base>
+void MalgStrategy<Base>::restart(size_t depth) {
+    assert(depth < 64);
+
+    m_n = depth;
+    m_tau = 1;
+    m_live = 0;
+    m_scheduled = 0;
+    m_active = 0;
+
+    m_thresholds.clear();
+    for (size_t m=0; m < m_n+1; m++) {
+        m_thresholds.push_back(rho(std::pow(2.0, m_n)) / rho(std::pow(2.0, m)));
+    }
+
+    // instances are created on first use, and then reset in place
+    while (m_instances.size() < m_n+1) {
+        m_instances.emplace_back(std::unique_ptr<instance_t>(nullptr));
+    }
+}
+
+
+template<class Base>
+size_t MalgStrategy<Base>::getAction() {
+    if (m_scheduled != m_tau) schedule();
+
+    return m_instances[m_active]->alg.getAction();
+}
+
+
+template<class Base>
+void MalgStrategy<Base>::update(size_t arm, int reward) {
+    if (m_scheduled != m_tau) schedule();
+
+    m_instances[m_active]->alg.update(arm, reward);
+    m_tau++;
+}
+
+
+template<class Base>
+double MalgStrategy<Base>::rho(double t) const {
+    double a = static_cast<double>(m_arms);
+    return std::sqrt(a/t) + a/t;
+}
+
+
+template<class Base>
+void MalgStrategy<Base>::schedule() {
+    // m_tau is a multiple of 2^m exactly for the levels up to top, whose
+    // instances have all just ended. they are visited from the top down, so
+    // the uniform variates are drawn in the same order as a scan of them all
+    size_t elapsed = m_tau - 1;
+    size_t top = elapsed == 0 ? m_n : std::min(m_n, lowestSetBit(elapsed));
+
+    m_live &= ~((static_cast<uint64_t>(2) << top) - 1);
+
+    for (size_t off=0; off <= top; off++) {
+        size_t m = top-off;
+
+        if (m_generator.uniform() < m_thresholds[m]) {
+            // reset the base instance, which runs for the next 2^m steps
+            if (m_instances[m].get() == nullptr) {
+                m_instances[m] = std::make_unique<instance_t>(
+                    m_seed.derive(m),  // independent seeds for each level
+                    m_arms
+                );
+            } else {
+                m_instances[m]->alg.reset();
+            }
+
+            m_live |= static_cast<uint64_t>(1) << m;
+        }
+    }
+
+    // the top level always starts with certainty, so some level is live
+    assert(m_live != 0);
+
+    m_active = lowestSetBit(m_live);
+    m_scheduled = m_tau;
+}
+
+
+template<class Base>
+void MalgStrategy<Base>::save(SnapshotWriter &out) const {
+    out.str(m_name);
+    out.u64(m_arms);
+    out.rng(m_generator);
+    out.u64(m_seed.seed);
+    out.u64(m_seed.stream);
+    out.u64(static_cast<uint64_t>(m_seed.kind));
+    out.u64(m_n);
+    out.u64(m_tau);
+    out.u64(m_live);
+    out.u64(m_scheduled);
+    out.u64(m_active);
+
+    out.u64(m_instances.size());
+    for (const auto &instance : m_instances) {
+        out.u64(instance ? 1 : 0);
+        if (!instance) continue;
+
+        instance->alg.save(out);
+    }
+}
+
+
+template<class Base>
+void MalgStrategy<Base>::restore(SnapshotReader &in) {
+    in.expect(m_name);
+    in.expect(m_arms, "number of arms");
+    in.rng(m_generator);
+    m_seed.seed = in.u64();
+    m_seed.stream = in.u64();
+    uint64_t kind = in.u64();
+    if (kind > static_cast<uint64_t>(RngKind::PCG64)) {
+        die_with_error("snapshot holds an unknown generator.");
+    }
+    m_seed.kind = static_cast<RngKind>(kind);
+
+    size_t depth = static_cast<size_t>(in.u64());
+    if (depth >= 64) die_with_error("snapshot holds an invalid MALG depth.");
+    restart(depth);
+
+    m_tau = static_cast<size_t>(in.u64());
+    m_live = in.u64();
+    m_scheduled = static_cast<size_t>(in.u64());
+    m_active = static_cast<size_t>(in.u64());
+
+    size_t n = static_cast<size_t>(in.u64());
+    if (n < m_n + 1 || m_active >= n) {
+        die_with_error("snapshot holds an invalid MALG schedule.");
+    }
+
+    m_instances.resize(n);
+    for (size_t m = 0; m < n; m++) {
+        if (in.u64() == 0) {
+            m_instances[m].reset();
+            continue;
+        }
+
+        if (m_instances[m].get() == nullptr) {
+            m_instances[m] = std::make_unique<instance_t>(
+                m_seed.derive(m), m_arms
+            );
+        }
+
+        m_instances[m]->alg.restore(in);
+    }
+}
+
+
 /* -------------------------------------------------------------------------- */
 
 
-class MasterUCB : public BanditStrategy {
+// MASTER over MALG with any base learner exposing optimism(), an upper
+// confidence bound on the best arm's mean at its last action, such as
+// UCBStrategy or KLUCBStrategy.
+//
+// MALG is run over blocks of doubling length, and the whole schedule is
+// restarted from the shortest block once either non-stationarity test
+// fails. each test needs only a running statistic of the block: the
+// reward total when each level last started, the sum of the optimism gaps,
+// and the least optimism seen, so a step costs O(1) amortised.
+template<class Base>
+class MasterStrategy : public BanditStrategy {
 
     public:
 
-        MasterUCB(size_t arms);
+        // the tests compare against rho inflated by confidence, or if that
+        // is 0, by the confidence terms of the analysis, which hold with a
+        // failure probability of 1/horizon but rarely fail in practice
+        MasterStrategy(
+            const rng_seed_t &seed,
+            size_t n_arms,
+            size_t horizon,
+            double confidence = 0.0,
+            const std::string &name = "MASTER"
+        );
 
         // get the action from MASTER
         size_t getAction() override;
@@ -92,14 +333,175 @@ class MasterUCB : public BanditStrategy {
         void update(size_t arm, int reward) override;
 
         // name of the method
-        std::string name() const override { return "MASTER"; }
+        std::string name() const override { return m_malg.name(); }
+
+        // the record holds the block statistics, followed by that of MALG.
+        // the test confidence is a parameter, so is not part of it
+        void save(SnapshotWriter &out) const override;
+
+        void restore(SnapshotReader &in) override;
 
     private:
 
+        // the regret bound used by the tests
         double rhoHat(double x) const;
+
+        // start a block of 2^depth steps
+        void startBlock(size_t depth);
+
+        MalgStrategy<Base> m_malg;
+
+        // the inflation of rho in rhoHat
+        double m_confidence;
+
+        // the order of the current block, and the steps taken within it
+        size_t m_depth;
+        size_t m_t;
+
+        // the optimism reported for the pending action
+        double m_optimism;
+
+        // the block's reward total, sum of optimism less reward and
+        // least optimism so far
+        double m_reward_sum;
+        double m_gap_sum;
+        double m_least_optimism;
+
+        // the block's reward total when each level last started
+        std::vector<double> m_level_start_reward;
 };
 
 
+// MASTER over the UCB1 and KL-UCB base learners
+typedef MasterStrategy<UCBStrategy> MasterUCB;
+typedef MasterStrategy<KLUCBStrategy> MasterKLUCB;
+
+
+/* -------------------------------------------------------------------------- */
+
+
+template<class Base>
+MasterStrategy<Base>::MasterStrategy(
+    const rng_seed_t &seed,
+    size_t n_arms,
+    size_t horizon,
+    double confidence,
+    const std::string &name
+) :
+    m_malg(seed, n_arms, 0, name),
+    m_confidence(confidence),
+    m_optimism(1.0)
+{
+    assert(confidence >= 0.0);
+
+    if (m_confidence == 0.0) {
+        double h = static_cast<double>(std::max<size_t>(horizon, 2));
+        m_confidence = 6.0 * (std::log2(h) + 1.0) * std::log(h * h);
+    }
+
+    startBlock(0);
+}
+
+
+template<class Base>
+size_t MasterStrategy<Base>::getAction() {
+    size_t arm = m_malg.getAction();
+    m_optimism = m_malg.activeLearner().optimism();
+
+    return arm;
+}
+
+
+template<class Base>
+void MasterStrategy<Base>::update(size_t arm, int reward) {
+    m_malg.update(arm, reward);
+    m_t++;
+
+    m_reward_sum += reward;
+    m_gap_sum += m_optimism - reward;
+    m_least_optimism = std::min(m_least_optimism, m_optimism);
+
+    // test 1: every instance of a level up to top has just ended, and was
+    // live over the 2^m steps since its level's reward total was recorded
+    size_t top = std::min(m_depth, lowestSetBit(m_t));
+    uint64_t live = m_malg.liveLevels();
+    bool failed = false;
+
+    for (size_t m=0; m <= top; m++) {
+        if ((live >> m) & 1) {
+            double len = std::ldexp(1.0, static_cast<int>(m));
+            double mean = (m_reward_sum - m_level_start_reward[m]) / len;
+            if (mean >= m_least_optimism + 9.0 * rhoHat(len)) failed = true;
+        }
+        m_level_start_reward[m] = m_reward_sum;
+    }
+
+    // test 2: the average optimism gap over the block
+    double t = static_cast<double>(m_t);
+    if (m_gap_sum / t >= 3.0 * rhoHat(t)) failed = true;
+
+    if (failed) {
+        startBlock(0);
+    } else if (m_t == static_cast<size_t>(1) << m_depth) {
+        startBlock(m_depth + 1);
+    }
+}
+
+
+template<class Base>
+void MasterStrategy<Base>::save(SnapshotWriter &out) const {
+    out.str(name());
+    out.u64(m_depth);
+    out.u64(m_t);
+    out.f64(m_optimism);
+    out.f64(m_reward_sum);
+    out.f64(m_gap_sum);
+    out.f64(m_least_optimism);
+    out.array(m_level_start_reward);
+
+    m_malg.save(out);
+}
+
+
+template<class Base>
+void MasterStrategy<Base>::restore(SnapshotReader &in) {
+    in.expect(name());
+    m_depth = static_cast<size_t>(in.u64());
+    m_t = static_cast<size_t>(in.u64());
+    m_optimism = in.f64();
+    m_reward_sum = in.f64();
+    m_gap_sum = in.f64();
+    m_least_optimism = in.f64();
+    in.array(m_level_start_reward);
+
+    if (m_level_start_reward.size() != m_depth + 1) {
+        die_with_error("snapshot holds an invalid MASTER block.");
+    }
+
+    m_malg.restore(in);
+}
+
+
+template<class Base>
+double MasterStrategy<Base>::rhoHat(double x) const {
+    return m_confidence * m_malg.rho(x);
+}
+
+
+template<class Base>
+void MasterStrategy<Base>::startBlock(size_t depth) {
+    m_depth = depth;
+    m_t = 0;
+
+    m_reward_sum = 0.0;
+    m_gap_sum = 0.0;
+    m_least_optimism = 1.0;
+    m_level_start_reward.assign(depth + 1, 0.0);
+
+    m_malg.restart(depth);
+}
+
+
 /* -------------------------------------------------------------------------- */
 
 
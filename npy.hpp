@@ -0,0 +1,65 @@
+#ifndef __NPY_HPP__
+#define __NPY_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+
+/* -------------------------------------------------------------------------- */
+
+
+/* write a row-major rows x cols matrix of doubles as a version 1.0 NumPy .npy
+   file, which np.load reads without any parsing of the data itself. returns
+   false if the file could not be written. */
+inline bool writeNpy(
+    const std::string &path,
+    const std::vector<double> &data,
+    size_t rows,
+    size_t cols
+) {
+    if (data.size() != rows * cols) return false;
+
+    // the data is written in native byte order, which the header records
+    const uint16_t probe = 1;
+    bool little = *reinterpret_cast<const unsigned char *>(&probe) == 1;
+
+    std::string header = "{'descr': '";
+    header += little ? "<f8" : ">f8";
+    header += "', 'fortran_order': False, 'shape': (";
+    header += std::to_string(rows) + ", " + std::to_string(cols) + "), }";
+
+    // the magic string, version and header length take 10 bytes, and the
+    // header is padded with spaces so the data starts 64 byte aligned
+    const size_t preamble = 10;
+    size_t total = preamble + header.size() + 1;
+    header.append((64 - total % 64) % 64, ' ');
+    header += '\n';
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out) return false;
+
+    uint16_t len = static_cast<uint16_t>(header.size());
+    unsigned char len_le[2] = {
+        static_cast<unsigned char>(len & 0xff),
+        static_cast<unsigned char>(len >> 8)
+    };
+
+    out.write("\x93NUMPY\x01\x00", 8);
+    out.write(reinterpret_cast<const char *>(len_le), 2);
+    out.write(header.data(), header.size());
+    out.write(
+        reinterpret_cast<const char *>(data.data()),
+        data.size() * sizeof(double)
+    );
+
+    return static_cast<bool>(out);
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+#endif // __NPY_HPP__
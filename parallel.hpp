@@ -0,0 +1,51 @@
+#ifndef __PARALLEL_HPP__
+#define __PARALLEL_HPP__
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+
+/* -------------------------------------------------------------------------- */
+
+
+/* invoke fn(i) for each i in [0, jobs) using the given number of threads.
+   threads claim the next unstarted job from a shared atomic counter, so
+   that uneven job lengths are balanced dynamically. fn must be safe to call
+   concurrently for distinct i; with a single thread, jobs run in order on
+   the calling thread. */
+template <class Fn>
+void parallelFor(size_t jobs, size_t threads, Fn fn) {
+    if (threads <= 1 || jobs <= 1) {
+        for (size_t i = 0; i < jobs; i++) fn(i);
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+
+    auto worker = [&]() {
+        for (;;) {
+            size_t i = next.fetch_add(1, std::memory_order_relaxed);
+            if (i >= jobs) return;
+            fn(i);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    size_t n = threads < jobs ? threads : jobs;
+    for (size_t t = 1; t < n; t++) {
+        pool.emplace_back(worker);
+    }
+
+    // the calling thread also does its share of the work
+    worker();
+
+    for (auto &t : pool) t.join();
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+#endif // __PARALLEL_HPP__
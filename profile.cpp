@@ -0,0 +1,384 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ==============================================================================
+
+#include "profile.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <ostream>
+#include <vector>
+
+#include "ptw.hpp"
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// sanitizers intercept allocation themselves, so are left to it
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define PROFILE_SANITIZED 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer) || \
+    __has_feature(memory_sanitizer)
+#define PROFILE_SANITIZED 1
+#endif
+#endif
+
+
+/* -------------------------------------------------------------------------- */
+
+
+namespace {
+
+// the allocations of each thread, counted only while it has live counters,
+// so that threads neither share a counter nor count when not profiling
+thread_local uint64_t t_allocations = 0;
+thread_local size_t t_counters = 0;
+
+// each power of two of latency is split into this many buckets
+constexpr size_t SubBuckets = 32;
+
+// latencies of up to 2^MaxExponent nanoseconds are told apart
+constexpr int MaxExponent = 64;
+
+} // namespace
+
+
+AllocationCounter::AllocationCounter() :
+    m_start(t_allocations)
+{
+    t_counters++;
+}
+
+
+AllocationCounter::~AllocationCounter() {
+    t_counters--;
+}
+
+
+uint64_t AllocationCounter::count() const {
+    return t_allocations - m_start;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+#ifdef PROFILE_SANITIZED
+bool allocationCounting() { return false; }
+#else
+bool allocationCounting() { return true; }
+
+
+/* the replaceable allocation functions, replaced as a complete set so that
+   every form of new is paired with a matching form of delete. memory of any
+   alignment is obtained from the C allocator, so is released by free. */
+namespace {
+
+void *allocate(size_t size, size_t alignment) {
+    if (t_counters > 0) t_allocations++;
+
+    if (size == 0) size = 1;
+    if (alignment <= alignof(std::max_align_t)) return std::malloc(size);
+
+    // aligned_alloc requires a multiple of the alignment
+    size = (size + alignment - 1) / alignment * alignment;
+    return std::aligned_alloc(alignment, size);
+}
+
+
+void *allocateOrThrow(size_t size, size_t alignment) {
+    void *p = allocate(size, alignment);
+    if (p == nullptr) throw std::bad_alloc();
+
+    return p;
+}
+
+} // namespace
+
+
+void *operator new(size_t size) {
+    return allocateOrThrow(size, 0);
+}
+
+void *operator new[](size_t size) {
+    return allocateOrThrow(size, 0);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    return allocate(size, 0);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return allocate(size, 0);
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+
+void operator delete(void *p, const std::nothrow_t &) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept {
+    std::free(p);
+}
+
+
+#if defined(__cpp_aligned_new)
+void *operator new(size_t size, std::align_val_t alignment) {
+    return allocateOrThrow(size, static_cast<size_t>(alignment));
+}
+
+void *operator new[](size_t size, std::align_val_t alignment) {
+    return allocateOrThrow(size, static_cast<size_t>(alignment));
+}
+
+void *operator new(
+    size_t size,
+    std::align_val_t alignment,
+    const std::nothrow_t &
+) noexcept {
+    return allocate(size, static_cast<size_t>(alignment));
+}
+
+void *operator new[](
+    size_t size,
+    std::align_val_t alignment,
+    const std::nothrow_t &
+) noexcept {
+    return allocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+
+void operator delete(void *p, size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p, size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(
+    void *p,
+    std::align_val_t,
+    const std::nothrow_t &
+) noexcept {
+    std::free(p);
+}
+
+void operator delete[](
+    void *p,
+    std::align_val_t,
+    const std::nothrow_t &
+) noexcept {
+    std::free(p);
+}
+#endif
+#endif // PROFILE_SANITIZED
+
+
+/* -------------------------------------------------------------------------- */
+
+
+LatencyHistogram::LatencyHistogram() :
+    m_buckets(1 + MaxExponent * SubBuckets, 0),
+    m_count(0),
+    m_total(0.0)
+{
+}
+
+
+void LatencyHistogram::record(double ns, size_t n) {
+    m_buckets[bucket(ns)] += n;
+    m_count += n;
+    m_total += ns * static_cast<double>(n);
+}
+
+
+double LatencyHistogram::quantile(double q) const {
+    if (m_count == 0) return 0.0;
+
+    // the smallest latency with at least a fraction q of those recorded at
+    // or below it
+    double rank = std::max(1.0, std::ceil(q * static_cast<double>(m_count)));
+
+    uint64_t seen = 0;
+    for (size_t b = 0; b < m_buckets.size(); b++) {
+        seen += m_buckets[b];
+        if (static_cast<double>(seen) >= rank) return centre(b);
+    }
+
+    return centre(m_buckets.size() - 1);
+}
+
+
+/* bucket 0 holds latencies under a nanosecond. above that, the latency
+   m 2^e, with m in [1/2, 1), falls in sub-bucket (m - 1/2) 2 SubBuckets of
+   the e'th power of two, so buckets are at most 1/SubBuckets wide relative
+   to their latencies. */
+size_t LatencyHistogram::bucket(double ns) {
+    if (!(ns >= 1.0)) return 0;
+
+    int e;
+    double m = std::frexp(ns, &e);
+    if (e > MaxExponent) return MaxExponent * SubBuckets;
+
+    size_t sub = static_cast<size_t>((m - 0.5) * 2.0 * SubBuckets);
+    sub = std::min(sub, SubBuckets - 1);
+
+    return 1 + static_cast<size_t>(e - 1) * SubBuckets + sub;
+}
+
+
+double LatencyHistogram::centre(size_t b) {
+    if (b == 0) return 0.5;
+
+    int e = static_cast<int>((b - 1) / SubBuckets) + 1;
+    double sub = static_cast<double>((b - 1) % SubBuckets);
+
+    return std::ldexp(0.5 + (sub + 0.5) / (2.0 * SubBuckets), e);
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+Profiler::Profiler() :
+    m_start_allocations(0),
+    m_ptw_updates(0),
+    m_changepoint_sum(0.0),
+    m_reset_sum(0.0),
+    m_ptw_actions(0),
+    m_entropy_sum(0.0)
+{
+}
+
+
+void Profiler::beginActions() {
+    begin();
+}
+
+
+/* the level posterior is read once the actions have been chosen, when it
+   is already up to date, so that no work is moved out of the timed call. */
+void Profiler::endActions(size_t n, const BanditStrategy &agent) {
+    end(m_actions, n);
+
+    const auto *posterior = agent.ptwLevelPosterior();
+    if (!posterior) return;
+
+    double entropy = 0.0;
+    for (double p : *posterior) {
+        if (p > 0.0) entropy -= p * std::log(p);
+    }
+    m_entropy_sum += entropy;
+    m_ptw_actions++;
+}
+
+
+void Profiler::beginUpdates() {
+    begin();
+}
+
+
+/* the change point of the update at time t is mscb(t), so those of the n
+   updates just processed follow from the model's time alone, leaving the
+   level posterior stale for the next timed action to refresh. */
+void Profiler::endUpdates(size_t n, const BanditStrategy &agent) {
+    end(m_updates, n);
+
+    ptw_profile_t ptw;
+    if (!agent.ptwProfile(ptw)) return;
+
+    for (size_t i = 0; i < n && i < ptw.updates; i++) {
+        size_t changepoint = ActivePTW::mscb(ptw.updates - i, ptw.depth);
+        m_changepoint_sum += static_cast<double>(changepoint);
+        m_reset_sum += static_cast<double>(ptw.depth - changepoint);
+        m_ptw_updates++;
+    }
+}
+
+
+void Profiler::begin() {
+    m_start_allocations = m_allocations.count();
+    m_start = steady_clock_t::now();
+}
+
+
+/* a call serving n decisions is recorded as n decisions of equal latency,
+   so that latencies are always per decision. */
+void Profiler::end(phase_t &phase, size_t n) {
+    auto stop = steady_clock_t::now();
+    uint64_t allocations = m_allocations.count() - m_start_allocations;
+
+    std::chrono::duration<double, std::nano> elapsed = stop - m_start;
+    if (n > 0) phase.latency.record(elapsed.count() / n, n);
+    phase.allocations += allocations;
+    phase.calls += n;
+}
+
+
+void Profiler::report(std::ostream &out) const {
+    out << "Profile:" << std::endl;
+    reportPhase(out, "getAction", m_actions);
+    reportPhase(out, "update", m_updates);
+
+    if (m_ptw_updates == 0) return;
+
+    double updates = static_cast<double>(m_ptw_updates);
+    out << "PTW mean change point depth: " << m_changepoint_sum / updates
+        << std::endl;
+    out << "PTW mean levels reset per update: " << m_reset_sum / updates
+        << std::endl;
+    out << "PTW mean level posterior entropy: "
+        << m_entropy_sum / static_cast<double>(m_ptw_actions) << " nats"
+        << std::endl;
+}
+
+
+void Profiler::reportPhase(
+    std::ostream &out,
+    const char *name,
+    const phase_t &phase
+) {
+    const auto &l = phase.latency;
+    double calls = static_cast<double>(std::max<uint64_t>(phase.calls, 1));
+
+    out << name << ": " << phase.calls << " calls, "
+        << l.total() * 1e-6 << "ms total, "
+        << l.total() / calls << "ns mean, "
+        << l.quantile(0.5) << "ns p50, "
+        << l.quantile(0.99) << "ns p99, "
+        << l.quantile(0.999) << "ns p999";
+
+    if (allocationCounting()) {
+        out << ", " << phase.allocations << " allocations ("
+            << static_cast<double>(phase.allocations) / calls << " per call)";
+    }
+    out << std::endl;
+}
+
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,142 @@
+#ifndef __PROFILE_HPP__
+#define __PROFILE_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <ostream>
+#include <vector>
+
+#include "bandits.hpp"
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// whether heap allocations can be counted. they are counted by replacing
+// the global allocation functions, which sanitizers replace themselves, so
+// sanitized builds do not count them
+bool allocationCounting();
+
+
+// counts the heap allocations made by the calling thread over its lifetime,
+// and must be used only by that thread. while no counter is alive, an
+// allocation costs a test of a thread local flag
+class AllocationCounter {
+
+    public:
+
+        AllocationCounter();
+        ~AllocationCounter();
+
+        AllocationCounter(const AllocationCounter &) = delete;
+        AllocationCounter &operator=(const AllocationCounter &) = delete;
+
+        // the number of allocations so far
+        uint64_t count() const;
+
+    private:
+
+        uint64_t m_start;
+};
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// a histogram of latencies in nanoseconds, with logarithmically spaced
+// buckets, so percentiles are accurate to a few percent in O(1) memory
+class LatencyHistogram {
+
+    public:
+
+        LatencyHistogram();
+
+        // record n latencies of ns nanoseconds
+        void record(double ns, size_t n = 1);
+
+        // the number of latencies recorded
+        uint64_t count() const { return m_count; }
+
+        // the total of the latencies recorded
+        double total() const { return m_total; }
+
+        // an estimate of the q'th quantile, for q in [0, 1]
+        double quantile(double q) const;
+
+    private:
+
+        // the bucket holding a latency, and the centre of a bucket
+        static size_t bucket(double ns);
+        static double centre(size_t b);
+
+        std::vector<uint64_t> m_buckets;
+        uint64_t m_count;
+        double m_total;
+};
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// records the hot path costs of an agent in text mode: the latency and heap
+// allocations of its actions and updates, and for PTW agents, the depth of
+// each update's change point, the levels it resets and the entropy of the
+// level posterior
+class Profiler {
+
+    public:
+
+        Profiler();
+
+        // bracket a call of agent choosing n actions
+        void beginActions();
+        void endActions(size_t n, const BanditStrategy &agent);
+
+        // bracket a call of agent learning from n pulls
+        void beginUpdates();
+        void endUpdates(size_t n, const BanditStrategy &agent);
+
+        // write a human readable report
+        void report(std::ostream &out) const;
+
+    private:
+
+        typedef std::chrono::steady_clock steady_clock_t;
+
+        // the costs of one kind of call
+        struct phase_t {
+            LatencyHistogram latency;
+            uint64_t allocations = 0;
+            uint64_t calls = 0;
+        };
+
+        void begin();
+        void end(phase_t &phase, size_t n);
+
+        static void reportPhase(
+            std::ostream &out,
+            const char *name,
+            const phase_t &phase
+        );
+
+        phase_t m_actions;
+        phase_t m_updates;
+
+        steady_clock_t::time_point m_start;
+        AllocationCounter m_allocations;
+        uint64_t m_start_allocations;
+
+        // PTW counters, summed over updates and over action calls
+        uint64_t m_ptw_updates;
+        double m_changepoint_sum;
+        double m_reset_sum;
+        uint64_t m_ptw_actions;
+        double m_entropy_sum;
+};
+
+
+/* -------------------------------------------------------------------------- */
+
+
+#endif // __PROFILE_HPP__
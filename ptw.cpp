@@ -23,34 +23,109 @@
 #include <numeric>
 #include <vector>
 
+#if defined(__has_include)
+#if __has_include(<bit>)
+#include <bit>
+#endif
+#endif
+
 #include "common.hpp"
+#include "snapshot.hpp"
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// the epoch tag of a free slot in a sparse level, which no epoch reaches
+static const uint64_t Vacant = ~static_cast<uint64_t>(0);
 
 
 /* -------------------------------------------------------------------------- */
 
 
 /* PTW constructor */
-ActivePTW::ActivePTW(size_t depth, size_t arms) :
+ActivePTW::ActivePTW(
+    size_t depth,
+    size_t arms,
+    bool rolling,
+    double log_precision
+) :
     m_index(0),
-    m_nodes(depth + 1, ActivePTWNode_t(arms)),
     m_depth(depth),
-    m_arms(arms)
+    m_arms(arms),
+    m_rolling(rolling),
+    m_fast_log(log_precision > 0.0 ?
+        &LogAddTable::forPrecision(log_precision) : nullptr),
+    m_epochs(depth + 1, 0),
+    m_log_marginal(depth + 1, 0.0),
+    m_log_weighted(depth + 1, 0.0),
+    m_log_buf(depth + 1, 0.0)
 {
-    double a = static_cast<double>(arms);
-    double x = (a-1.0)/a;
-    LogStopWeight = std::log(x);
-    LogSplitWeight = std::log(1.0 - x);
+    priorWeights(arms, LogStopWeight, LogSplitWeight);
+
+    assert(m_depth >= 1 && m_depth < 64);
+
+    layout(m_depth);
+}
+
+
+/* a level is sparse when its table, sized to be at most half full, has no
+   more than half as many slots as there are arms. below SparseArms arms a
+   dense level is small, and cheaper to index. */
+void ActivePTW::layout(size_t depth) {
+    m_levels.resize(depth + 1);
+
+    for (size_t j = 0; j <= depth; j++) {
+        size_t span = depth - j;
+
+        m_levels[j].bits = span + 1;
+        m_levels[j].sparse = m_arms >= SparseArms && span + 2 < 64 &&
+            (static_cast<size_t>(1) << (span + 2)) <= m_arms;
+    }
+
+    // the dense levels first, then the sparse
+    size_t offset = 0;
+    for (auto &lv : m_levels) {
+        if (lv.sparse) continue;
+        lv.offset = offset;
+        offset += m_arms;
+    }
+
+    m_sparse_offset = offset;
+    for (auto &lv : m_levels) {
+        if (!lv.sparse) continue;
+        lv.offset = offset;
+        offset += static_cast<size_t>(1) << lv.bits;
+    }
+
+    m_alphas.assign(offset, KT_Alpha);
+    m_betas.assign(offset, KT_Alpha);
+    m_stamps.assign(offset, 0);
+    std::fill(m_stamps.begin() + m_sparse_offset, m_stamps.end(), Vacant);
+    m_keys.assign(offset - m_sparse_offset, 0);
+}
+
+
+/* the smallest depth d >= 1 such that 2^d >= trials */
+size_t ActivePTW::depthForHorizon(size_t trials) {
+    size_t depth = 1;
+    while (depth < 63 && (static_cast<index_t>(1) << depth) < trials) {
+        depth++;
+    }
+
+    return depth;
 }
 
 
 /* the probability of seeing a particular symbol next */
-double ActivePTW::prob(int r, size_t k) {
-    auto post = levelPosterior();
+double ActivePTW::prob(int r, size_t k) const {
+    const auto &post = levelPosterior();
 
     std::vector<double> probs;
     probs.reserve(post.size());
     for (size_t i = 0; i < post.size(); i++) {
-        probs.emplace_back(m_nodes[i].prob(r, k));
+        auto ss = posterior(i, k);
+        probs.emplace_back((r ? ss.first : ss.second) / (ss.first + ss.second));
     }
 
     return std::inner_product(post.begin(), post.end(), probs.begin(), 0.0);
@@ -59,91 +134,383 @@ double ActivePTW::prob(int r, size_t k) {
 
 /* process a new piece of sensory experience */
 void ActivePTW::update(int r, size_t k) {
-    assert(m_index < (1 << m_depth));
+    if (m_rolling && m_index == (static_cast<index_t>(1) << m_depth)) {
+        grow();
+    }
+
+    assert(m_index < (static_cast<index_t>(1) << m_depth));
 
     // mscb requires the current 1-based time
-    size_t i = mscb(m_index + 1);
+    size_t i = mscb(m_index + 1, m_depth);
 
     // save weighted probability in change point's parent
-    m_nodes[i].m_log_buf = m_nodes[i + 1].m_log_weighted;
+    m_log_buf[i] = m_log_weighted[i + 1];
 
     // now reset statistics from the change point downwards
-    for (size_t j = i + 1; j <= m_depth; j++) {
-        m_nodes[j] = ActivePTWNode_t(m_arms);
+    resetLevels(
+        i + 1, m_depth, m_epochs.data(), m_log_marginal.data(),
+        m_log_weighted.data(), m_log_buf.data()
+    );
+
+    // update the KT estimator of arm k at every level, accumulating the
+    // log probability of r into each level's log marginal
+    for (size_t j = 0; j <= m_depth; j++) {
+        size_t s = touch(j, k);
+        countKT(r, m_alphas[s], m_betas[s], m_log_marginal[j], m_fast_log);
     }
 
-    // compute weighted probability from bottom up
-    ActivePTWNode_t& n = m_nodes[m_depth];
-    n.m_model[k].update(r);
-    n.m_log_weighted = n.logMarginal();
+    weigh(
+        m_depth, LogStopWeight, LogSplitWeight, m_log_marginal.data(),
+        m_log_buf.data(), m_log_weighted.data(), m_fast_log
+    );
+
+    m_index++;
+    m_level_posterior_stale = true;
+}
+
 
-    for (size_t i = 1; i <= m_depth; i++) {
-        size_t idx = m_depth - i;
-        m_nodes[idx].m_model[k].update(r);
-        double lhs = LogStopWeight + m_nodes[idx].logMarginal();
-        double rhs = LogSplitWeight;
-        rhs += m_nodes[idx + 1].m_log_weighted;
-        rhs += m_nodes[idx].m_log_buf;
-        m_nodes[idx].m_log_weighted = logAdd(lhs, rhs);
+/* the PTW prior stops at a level with probability (arms-1)/arms, and
+   splits it otherwise. */
+void ActivePTW::priorWeights(
+    size_t arms,
+    double &log_stop,
+    double &log_split
+) {
+    double a = static_cast<double>(arms);
+    double x = (a-1.0)/a;
+    log_stop = std::log(x);
+    log_split = std::log(1.0 - x);
+}
+
+
+/* the per arm statistics of a level are cleared lazily, when next touched
+   in the new epoch. */
+void ActivePTW::resetLevels(
+    size_t from,
+    size_t depth,
+    uint64_t *epochs,
+    double *log_marginal,
+    double *log_weighted,
+    double *log_buf
+) {
+    for (size_t j = from; j <= depth; j++) {
+        epochs[j]++;
+        log_marginal[j] = 0.0;
+        log_weighted[j] = 0.0;
+        log_buf[j] = 0.0;
     }
+}
 
-    m_index++;
+
+/* after 2^d pulls, a tree of depth d is complete and becomes the left subtree
+   of a new root, whose KT statistics are those of the old root since both
+   cover all data seen so far. the new root's right subtree is empty; the
+   next update has its change point at the root, which stores the completed
+   left subtree's weighted probability and resets every level beneath it,
+   so the result is exactly a PTW model of depth d+1. */
+void ActivePTW::grow() {
+    assert(m_depth < 63);
+
+    // the old root's statistics, which the new root takes on
+    std::vector<double> alphas(m_arms), betas(m_arms);
+    posteriors(0, alphas.data(), betas.data());
+
+    std::vector<level_t> levels = m_levels;
+    std::vector<double> old_alphas, old_betas;
+    std::vector<uint64_t> old_stamps, old_keys;
+    old_alphas.swap(m_alphas);
+    old_betas.swap(m_betas);
+    old_stamps.swap(m_stamps);
+    old_keys.swap(m_keys);
+    size_t old_sparse_offset = m_sparse_offset;
+
+    layout(m_depth + 1);
+
+    // each level moves one deeper, keeping the same span of time, and so
+    // the same representation
+    for (size_t j = 0; j <= m_depth; j++) {
+        const level_t &from = levels[j];
+        const level_t &to = m_levels[j + 1];
+        assert(from.sparse == to.sparse && from.bits == to.bits);
+
+        size_t n = from.sparse ? static_cast<size_t>(1) << from.bits : m_arms;
+        std::copy_n(&old_alphas[from.offset], n, &m_alphas[to.offset]);
+        std::copy_n(&old_betas[from.offset], n, &m_betas[to.offset]);
+        std::copy_n(&old_stamps[from.offset], n, &m_stamps[to.offset]);
+
+        if (from.sparse) {
+            std::copy_n(
+                &old_keys[from.offset - old_sparse_offset], n,
+                &m_keys[to.offset - m_sparse_offset]
+            );
+        }
+    }
+
+    m_epochs.insert(m_epochs.begin(), m_epochs.front());
+    m_log_marginal.insert(m_log_marginal.begin(), m_log_marginal.front());
+    m_log_weighted.insert(m_log_weighted.begin(), m_log_weighted.front());
+    m_log_buf.insert(m_log_buf.begin(), 0.0);
+
+    m_depth++;
+
+    // only the arms the old root touched differ from the KT prior
+    for (size_t arm = 0; arm < m_arms; arm++) {
+        if (alphas[arm] == KT_Alpha && betas[arm] == KT_Alpha) continue;
+
+        size_t s = touch(0, arm);
+        m_alphas[s] = alphas[arm];
+        m_betas[s] = betas[arm];
+    }
+}
+
+
+size_t ActivePTW::touch(size_t level, size_t arm) {
+    size_t s = slot(level, arm);
+
+    if (m_stamps[s] != m_epochs[level]) {
+        m_alphas[s] = KT_Alpha;
+        m_betas[s] = KT_Alpha;
+        m_stamps[s] = m_epochs[level];
+
+        if (m_levels[level].sparse) m_keys[s - m_sparse_offset] = arm;
+    }
+
+    return s;
 }
 
 
 /* the number of bits to the left of the most significant
    location at which times t-1 and t-2 differ, where t is
-   the 1 based current time. */
-size_t ActivePTW::mscb(index_t t) const {
+   the 1 based current time. the highest differing bit is
+   the highest set bit of (t-1) ^ (t-2), so the count is
+   the depth less that bit's width, found in constant time. */
+size_t ActivePTW::mscb(index_t t, size_t depth) {
     if (t == 1) return 0;
 
-    size_t c = m_depth - 1;
-    size_t cnt = 0;
+    index_t diff = (t - 1) ^ (t - 2);
 
-    for (index_t i = 0; i < m_depth; i++) {
-        index_t tm1 = t - 1, tm2 = t - 2;
-        index_t mask = static_cast<uint64_t>(1) << c;
+#if defined(__cpp_lib_bitops)
+    size_t width = std::bit_width(diff);
+#elif defined(__GNUC__)
+    size_t width = 64 - __builtin_clzll(diff);
+#else
+    size_t width = 0;
+    while (diff >> width) width++;
+#endif
 
-        if ((tm1 & mask) != (tm2 & mask)) return cnt;
+    return depth - std::min(width, depth);
+}
 
-        c--, cnt++;
-    }
 
-    return cnt;
+/* Compute the posterior weights for current temporal discretization level. */
+const std::vector<double> &ActivePTW::levelPosterior() const {
+    refreshLevelPosterior();
+
+    return m_level_posterior;
 }
 
 
-/* Compute the posterior weights for current temporal discretization level. */
-std::vector<double> ActivePTW::levelPosterior() const {
-    double posterior_mass_left = 1.0;
+const AliasTable &ActivePTW::levelSampler() const {
+    refreshLevelPosterior();
+
+    return m_level_sampler;
+}
 
-    std::vector<double> dest;
+
+void ActivePTW::refreshLevelPosterior() const {
+    if (!m_level_posterior_stale) return;
+
+    m_level_posterior.resize(m_depth + 1);
+    computeLevelPosterior(
+        m_depth, LogStopWeight, m_log_marginal.data(), m_log_weighted.data(),
+        m_level_posterior.data()
+    );
+
+    m_level_sampler.build(m_level_posterior);
+    m_level_posterior_stale = false;
+}
+
+
+void ActivePTW::computeLevelPosterior(
+    size_t depth,
+    double log_stop,
+    const double *log_marginal,
+    const double *log_weighted,
+    double *out
+) {
+    double posterior_mass_left = 1.0;
 
     // compute the posterior weights of each level from top down
-    for (size_t i = 0; i <= m_depth; i++) {
+    for (size_t i = 0; i <= depth; i++) {
         // compute log posterior of stopping at level i
-        double x = LogStopWeight + m_nodes[i].logMarginal();
-        x -= m_nodes[i].m_log_weighted;
+        double x = log_stop + log_marginal[i];
+        x -= log_weighted[i];
         double stop_post = std::exp(x);
 
-        dest.push_back(posterior_mass_left * stop_post);
+        out[i] = posterior_mass_left * stop_post;
         posterior_mass_left *= (1.0 - stop_post);
 
-        assert(dest.back() >= 0.0 && dest.back() <= 1.0);
+        assert(out[i] >= 0.0 && out[i] <= 1.0);
 
         // for numerical stability
         posterior_mass_left = std::max(posterior_mass_left, 0.0);
         assert(posterior_mass_left >= 0.0 && posterior_mass_left <= 1.0);
     }
+}
 
-    assert(dest.size() == m_depth + 1);
 
-    return dest;
+beta_suff_stats_t ActivePTW::posterior(size_t level, size_t arm_index) const {
+    size_t s = slot(level, arm_index);
+
+    if (m_stamps[s] != m_epochs[level]) {
+        return beta_suff_stats_t(KT_Alpha, KT_Alpha);
+    }
+
+    return beta_suff_stats_t(m_alphas[s], m_betas[s]);
 }
 
 
-beta_suff_stats_t ActivePTW::posterior(size_t level, size_t arm_index) const {
-    return m_nodes[level].m_model[arm_index].posterior();
+/* for a dense level, a branch free gather over contiguous memory, which
+   compilers will vectorize when targeting AVX2/NEON. a sparse level is
+   instead scattered over the KT prior. */
+void ActivePTW::posteriors(
+    size_t level,
+    double *alphas,
+    double *betas
+) const {
+    const level_t &lv = m_levels[level];
+    const double *a = &m_alphas[lv.offset];
+    const double *b = &m_betas[lv.offset];
+    const uint64_t *stamps = &m_stamps[lv.offset];
+    const uint64_t epoch = m_epochs[level];
+
+    if (lv.sparse) {
+        const uint64_t *keys = &m_keys[lv.offset - m_sparse_offset];
+
+        std::fill(alphas, alphas + m_arms, KT_Alpha);
+        std::fill(betas, betas + m_arms, KT_Alpha);
+
+        for (size_t i = 0; i < (static_cast<size_t>(1) << lv.bits); i++) {
+            if (stamps[i] != epoch) continue;
+            alphas[keys[i]] = a[i];
+            betas[keys[i]] = b[i];
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < m_arms; i++) {
+        bool fresh = stamps[i] == epoch;
+        alphas[i] = fresh ? a[i] : KT_Alpha;
+        betas[i] = fresh ? b[i] : KT_Alpha;
+    }
+}
+
+
+/* the per level statistics, then each level as laid out in the model: a
+   dense level as arrays over every arm, and a sparse level as a record of
+   the arm, alpha and beta of each arm it holds, so a snapshot is no larger
+   than the model. */
+void ActivePTW::save(SnapshotWriter &out) const {
+    out.u64(m_arms);
+    out.u64(m_rolling);
+    out.u64(m_depth);
+    out.u64(m_index);
+
+    out.array(m_epochs);
+    out.array(m_log_marginal);
+    out.array(m_log_weighted);
+    out.array(m_log_buf);
+
+    for (size_t j = 0; j <= m_depth; j++) {
+        const level_t &lv = m_levels[j];
+        out.u64(lv.sparse);
+
+        if (!lv.sparse) {
+            out.array(&m_alphas[lv.offset], m_arms);
+            out.array(&m_betas[lv.offset], m_arms);
+            out.array(&m_stamps[lv.offset], m_arms);
+            continue;
+        }
+
+        size_t slots = static_cast<size_t>(1) << lv.bits;
+        size_t present = 0;
+        for (size_t i = 0; i < slots; i++) {
+            if (m_stamps[lv.offset + i] == m_epochs[j]) present++;
+        }
+
+        out.u64(present);
+        for (size_t i = 0; i < slots; i++) {
+            size_t s = lv.offset + i;
+            if (m_stamps[s] != m_epochs[j]) continue;
+
+            out.u64(m_keys[s - m_sparse_offset]);
+            out.f64(m_alphas[s]);
+            out.f64(m_betas[s]);
+        }
+    }
+}
+
+
+void ActivePTW::restore(SnapshotReader &in) {
+    in.expect(m_arms, "number of arms");
+    in.expect(m_rolling, "rolling flag");
+
+    size_t depth = static_cast<size_t>(in.u64());
+    bool grown = m_rolling && depth > m_depth && depth < 64;
+    if (depth != m_depth && !grown) {
+        die_with_error("snapshot holds a PTW model of a different depth.");
+    }
+
+    m_depth = depth;
+    m_index = in.u64();
+    if (m_index > (static_cast<index_t>(1) << m_depth)) {
+        die_with_error("snapshot holds a PTW model past its horizon.");
+    }
+
+    size_t levels = m_depth + 1;
+    m_epochs.resize(levels);
+    m_log_marginal.resize(levels);
+    m_log_weighted.resize(levels);
+    m_log_buf.resize(levels);
+    layout(m_depth);
+
+    in.array(m_epochs.data(), levels);
+    in.array(m_log_marginal.data(), levels);
+    in.array(m_log_weighted.data(), levels);
+    in.array(m_log_buf.data(), levels);
+
+    // the layout follows from the number of arms and depth alone, so the
+    // writer's levels are sparse exactly where the model's are
+    for (size_t j = 0; j < levels; j++) {
+        const level_t &lv = m_levels[j];
+        in.expect(lv.sparse, "PTW level representation");
+
+        if (!lv.sparse) {
+            in.array(&m_alphas[lv.offset], m_arms);
+            in.array(&m_betas[lv.offset], m_arms);
+            in.array(&m_stamps[lv.offset], m_arms);
+            continue;
+        }
+
+        // a segment at this level touches at most half its table's slots
+        uint64_t present = in.u64();
+        if (present > (static_cast<size_t>(1) << (lv.bits - 1))) {
+            die_with_error("snapshot holds an overfull PTW level.");
+        }
+
+        for (uint64_t k = 0; k < present; k++) {
+            uint64_t arm = in.u64();
+            if (arm >= m_arms) {
+                die_with_error("snapshot holds an invalid PTW arm.");
+            }
+
+            size_t s = touch(j, static_cast<size_t>(arm));
+            m_alphas[s] = in.f64();
+            m_betas[s] = in.f64();
+        }
+    }
+
+    m_level_posterior_stale = true;
 }
 
 
@@ -6,7 +6,12 @@
 #include <cstdint>
 #include <vector>
 
+#include "alias.hpp"
 #include "common.hpp"
+#include "fastlog.hpp"
+
+class SnapshotReader;
+class SnapshotWriter;
 
 
 /* -------------------------------------------------------------------------- */
@@ -28,7 +33,7 @@ class KTEstimator {
         }
 
         // the probability of seeing a particular symbol next
-        double prob(int b) {
+        double prob(int b) const {
 
             double num = double(m_counts[b]) + KT_Alpha;
             double den = double(m_counts[0] + m_counts[1]) + KT_Alpha2;
@@ -54,6 +59,16 @@ class KTEstimator {
             return beta_suff_stats_t(alpha, beta);
         }
 
+        // the number of zeros and ones processed
+        uint64_t count(int b) const { return m_counts[b]; }
+
+        // resume from the counts and log marginal of another estimator
+        void assign(uint64_t zeros, uint64_t ones, double log_marginal) {
+            m_counts[0] = zeros;
+            m_counts[1] = ones;
+            m_log_kt = log_marginal;
+        }
+
     private:
 
         double m_log_kt;
@@ -67,69 +82,232 @@ class KTEstimator {
 // Active Partition Tree Weighting
 class ActivePTW {
 
-    struct ActivePTWNode_t {
+    public:
 
-        ActivePTWNode_t(size_t arms) :
-            m_model(arms),
-            m_log_weighted(0.0),
-            m_log_buf(0.0)
-        {
-        }
+        typedef uint64_t index_t;
 
-        // the probability of a segment is equal to the product
-        // of each subsequence explained by each arm
-        double logMarginal() const {
+        // the number of arms from which levels may be stored sparsely
+        static constexpr size_t SparseArms = 256;
 
-            double rval = 0.0;
-            for (size_t i = 0; i < m_model.size(); i++) {
-                rval += m_model[i].logMarginal();
-            }
+        // a PTW model over a horizon of 2^depth pulls. a rolling model
+        // instead doubles its horizon on demand, one level at a time, and
+        // so can process an unbounded stream. a positive log_precision
+        // selects table driven log arithmetic, with each logAdd accurate
+        // to within log_precision, in place of the exact library calls
+        ActivePTW(
+            size_t depth,
+            size_t arms,
+            bool rolling = false,
+            double log_precision = 0.0
+        );
 
-            return rval;
-        }
+        // the smallest depth whose horizon covers a given number of pulls
+        static size_t depthForHorizon(size_t trials);
 
-        double prob(int r, size_t k) { return m_model[k].prob(r); }
+        // the current depth of the tree
+        size_t depth() const { return m_depth; }
 
-        std::vector<KTEstimator> m_model;
-        double m_log_weighted;
-        double m_log_buf;
-    };
+        // the number of updates processed
+        index_t updates() const { return m_index; }
 
+        // the number of per arm statistics allocated over every level
+        size_t slots() const { return m_alphas.size(); }
 
-    public:
+        // the number of bits to the left of the most significant
+        // location at which times t-1 and t-2 differ, where t is
+        // the 1 based representation of the current time and
+        // depth is the number of bits considered
+        static size_t mscb(index_t t, size_t depth);
+
+        // the KT prior of every arm's statistics
+        static constexpr double KT_Alpha = 0.5;
+
+        // the log prior weights of stopping at a level and of splitting it,
+        // for a model of the given number of arms
+        static void priorWeights(
+            size_t arms,
+            double &log_stop,
+            double &log_split
+        );
+
+        // discard the per level statistics of levels from..depth, whose per
+        // arm statistics are then cleared lazily, as their epoch has moved
+        static void resetLevels(
+            size_t from,
+            size_t depth,
+            uint64_t *epochs,
+            double *log_marginal,
+            double *log_weighted,
+            double *log_buf
+        );
+
+        // count reward r in an arm's KT statistics at some level, adding
+        // the log probability they gave r to that level's log marginal,
+        // taken from the half integer table if fast_log is set
+        static void countKT(
+            int r,
+            double &alpha,
+            double &beta,
+            double &log_marginal,
+            const LogAddTable *fast_log
+        ) {
+            double &a = r ? alpha : beta;
+            double total = alpha + beta;
+            log_marginal += fast_log ?
+                logKTRatio(a, total) : std::log(a / total);
+            a += 1.0;
+        }
 
-        typedef uint64_t index_t;
+        // compute the weighted probability of every level from depth up,
+        // given each level's log marginal and the weighted probability
+        // buffered at it, using fast_log for the sums if set. defined here
+        // so that a caller of fixed depth can unroll the chain
+        static void weigh(
+            size_t depth,
+            double log_stop,
+            double log_split,
+            const double *log_marginal,
+            const double *log_buf,
+            double *log_weighted,
+            const LogAddTable *fast_log
+        ) {
+            log_weighted[depth] = log_marginal[depth];
+
+            for (size_t i = 1; i <= depth; i++) {
+                size_t idx = depth - i;
+                double lhs = log_stop + log_marginal[idx];
+                double rhs = log_split;
+                rhs += log_weighted[idx + 1];
+                rhs += log_buf[idx];
+                log_weighted[idx] = fast_log ?
+                    fast_log->logAdd(lhs, rhs) : logAdd(lhs, rhs);
+            }
+        }
 
-        ActivePTW(size_t depth, size_t arms);
+        // compute the posterior probability of stopping at each level from
+        // the top down, writing depth+1 entries to out
+        static void computeLevelPosterior(
+            size_t depth,
+            double log_stop,
+            const double *log_marginal,
+            const double *log_weighted,
+            double *out
+        );
 
         // the probability of seeing a reward r next if arm k pulled
-        double prob(int r, size_t k);
+        double prob(int r, size_t k) const;
 
         // the logarithm of the probability of all processed bits
-        double logMarginal() const { return m_nodes[0].m_log_weighted; }
+        double logMarginal() const { return m_log_weighted[0]; }
 
         // process a new piece of experience, indicating arm k
         // pulled with reward r
         void update(int r, size_t k);
 
-        // the posterior probability of being in a segment of length 2^k
-        std::vector<double> levelPosterior() const;
+        // the posterior probability of being in a segment of length 2^k,
+        // computed at most once between updates
+        const std::vector<double> &levelPosterior() const;
+
+        // a sampler for the level posterior, rebuilt at most once
+        // between updates
+        const AliasTable &levelSampler() const;
 
         // given a segmentation level, and choice of arm, what is the posterior
         // probability which governs the arm's latent reward distribution
         beta_suff_stats_t posterior(size_t level, size_t arm_index) const;
 
+        // write the beta posterior parameters of every arm at a given
+        // level into the caller provided arrays, each of size arms
+        void posteriors(size_t level, double *alphas, double *betas) const;
+
+        // append the statistics to a snapshot, each level as it is held
+        void save(SnapshotWriter &out) const;
+
+        // resume from statistics written by save() for the same number of
+        // arms. a rolling model takes on the depth it had grown to, any
+        // other must have the same depth
+        void restore(SnapshotReader &in);
+
     private:
 
-        // the number of bits to the left of the most significant
-        // location at which times t-1 and t-2 differ, where t is
-        // the 1 based representation of the current time
-        size_t mscb(index_t t) const;
+        // where the per arm statistics of a level are stored. a dense level
+        // holds every arm, at offset + arm. a segment at level j spans
+        // 2^(depth-j) pulls, so touches at most that many arms, and a level
+        // where that is a small fraction of a large catalog is sparse: its
+        // arms are held in an open addressing table of 2^bits slots from
+        // offset, keyed by arm and never more than half full
+        struct level_t {
+            size_t offset;
+            size_t bits;
+            bool sparse;
+        };
+
+        // the storage of each level of a model of the given depth, with
+        // every arm at the KT prior
+        void layout(size_t depth);
+
+        // double the horizon by adding a new root above a complete tree
+        void grow();
+
+        // recompute the level posterior and its sampler if stale
+        void refreshLevelPosterior() const;
+
+        // the location of an arm's statistics at a given level, or for a
+        // sparse level where they are absent, the free slot for them
+        size_t slot(size_t level, size_t arm) const {
+            const level_t &lv = m_levels[level];
+            if (!lv.sparse) return lv.offset + arm;
+
+            const uint64_t epoch = m_epochs[level];
+            const size_t mask = (static_cast<size_t>(1) << lv.bits) - 1;
+
+            // fibonacci hashing, then linear probing
+            size_t i = (arm * 0x9e3779b97f4a7c15ULL) >> (64 - lv.bits);
+            while (m_stamps[lv.offset + i] == epoch &&
+                m_keys[lv.offset + i - m_sparse_offset] != arm) {
+                i = (i + 1) & mask;
+            }
+
+            return lv.offset + i;
+        }
+
+        // the index of an arm's statistics at a given level, first clearing
+        // them to the KT prior if they are stale
+        size_t touch(size_t level, size_t arm);
 
         index_t m_index;
-        std::vector<ActivePTWNode_t> m_nodes;
         size_t m_depth;
         size_t m_arms;
+        bool m_rolling;
+
+        // the table driven log arithmetic, or nullptr for the exact path
+        const LogAddTable *m_fast_log;
+
+        // per level and arm statistics, stored contiguously level by level.
+        // the beta posterior parameters of each KT estimator are kept
+        // directly, and an arm whose epoch tag differs from its level's
+        // epoch is implicitly at the KT prior, so that resetting a level
+        // is O(1) and never touches the heap. the sparse levels follow the
+        // dense, from m_sparse_offset, and their slots also record the arm
+        // they hold
+        std::vector<level_t> m_levels;
+        std::vector<double> m_alphas;
+        std::vector<double> m_betas;
+        std::vector<uint64_t> m_stamps;
+        std::vector<uint64_t> m_keys;
+        size_t m_sparse_offset;
+
+        // per level statistics. the log marginal of a level is the sum of
+        // the KT log marginals of each arm, maintained as a running total
+        std::vector<uint64_t> m_epochs;
+        std::vector<double> m_log_marginal;
+        std::vector<double> m_log_weighted;
+        std::vector<double> m_log_buf;
+
+        // cached level posterior, invalidated by each update
+        mutable std::vector<double> m_level_posterior;
+        mutable AliasTable m_level_sampler;
+        mutable bool m_level_posterior_stale = true;
 
         // parameters to define the PTW prior
         double LogSplitWeight = std::log(0.5);
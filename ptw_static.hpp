@@ -0,0 +1,244 @@
+#ifndef __PTW_STATIC_HPP__
+#define __PTW_STATIC_HPP__
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "alias.hpp"
+#include "common.hpp"
+#include "ptw.hpp"
+#include "snapshot.hpp"
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// Active Partition Tree Weighting with the depth and number of arms fixed at
+// compile time. the state lives in fixed size arrays inside the object, so
+// every loop bound is a constant the compiler can unroll, and no update
+// touches the heap. the prior and the per level maths are ActivePTW's own
+// helpers, which remains the fallback for any other shape, so both give
+// bit-identical results.
+template<size_t Depth, size_t Arms>
+class StaticActivePTW {
+
+    static_assert(Depth >= 1 && Depth < 64, "invalid PTW depth");
+    static_assert(Arms >= 1, "invalid number of arms");
+
+    // every level of ActivePTW is then dense, as every level here is
+    static_assert(Arms < ActivePTW::SparseArms, "too many arms");
+
+    public:
+
+        typedef ActivePTW::index_t index_t;
+
+        static constexpr size_t Levels = Depth + 1;
+
+        StaticActivePTW() {
+            m_alphas.fill(KT_Alpha);
+            m_betas.fill(KT_Alpha);
+            m_stamps.fill(0);
+            m_epochs.fill(0);
+            m_log_marginal.fill(0.0);
+            m_log_weighted.fill(0.0);
+            m_log_buf.fill(0.0);
+            m_level_posterior.resize(Levels);
+
+            ActivePTW::priorWeights(Arms, LogStopWeight, LogSplitWeight);
+        }
+
+        // the depth of the tree
+        static constexpr size_t depth() { return Depth; }
+
+        // the number of arms
+        static constexpr size_t arms() { return Arms; }
+
+        // the number of updates processed
+        index_t updates() const { return m_index; }
+
+        // the logarithm of the probability of all processed bits
+        double logMarginal() const { return m_log_weighted[0]; }
+
+        // process a new piece of experience, indicating arm k
+        // pulled with reward r
+        void update(int r, size_t k) {
+            assert(m_index < (static_cast<index_t>(1) << Depth));
+            assert(k < Arms);
+
+            // mscb requires the current 1-based time
+            size_t i = ActivePTW::mscb(m_index + 1, Depth);
+
+            // save weighted probability in change point's parent
+            m_log_buf[i] = m_log_weighted[i + 1];
+
+            // now reset statistics from the change point downwards
+            ActivePTW::resetLevels(
+                i + 1, Depth, m_epochs.data(), m_log_marginal.data(),
+                m_log_weighted.data(), m_log_buf.data()
+            );
+
+            // update the KT estimator of arm k at every level
+            for (size_t j = 0; j < Levels; j++) {
+                size_t s = j * Arms + k;
+
+                if (m_stamps[s] != m_epochs[j]) {
+                    m_alphas[s] = KT_Alpha;
+                    m_betas[s] = KT_Alpha;
+                    m_stamps[s] = m_epochs[j];
+                }
+
+                ActivePTW::countKT(
+                    r, m_alphas[s], m_betas[s], m_log_marginal[j], nullptr
+                );
+            }
+
+            ActivePTW::weigh(
+                Depth, LogStopWeight, LogSplitWeight, m_log_marginal.data(),
+                m_log_buf.data(), m_log_weighted.data(), nullptr
+            );
+
+            m_index++;
+            m_level_posterior_stale = true;
+        }
+
+        // the posterior probability of being in a segment of length 2^k,
+        // computed at most once between updates
+        const std::vector<double> &levelPosterior() const {
+            refreshLevelPosterior();
+
+            return m_level_posterior;
+        }
+
+        // a sampler for the level posterior
+        const AliasTable &levelSampler() const {
+            refreshLevelPosterior();
+
+            return m_level_sampler;
+        }
+
+        // the beta posterior of an arm at a given segmentation level
+        beta_suff_stats_t posterior(size_t level, size_t arm) const {
+            size_t s = level * Arms + arm;
+
+            if (m_stamps[s] != m_epochs[level]) {
+                return beta_suff_stats_t(KT_Alpha, KT_Alpha);
+            }
+
+            return beta_suff_stats_t(m_alphas[s], m_betas[s]);
+        }
+
+        // write the beta posterior parameters of every arm at a given level
+        void posteriors(
+            size_t level,
+            std::array<double, Arms> &alphas,
+            std::array<double, Arms> &betas
+        ) const {
+            const double *a = &m_alphas[level * Arms];
+            const double *b = &m_betas[level * Arms];
+            const uint64_t *stamps = &m_stamps[level * Arms];
+            const uint64_t epoch = m_epochs[level];
+
+            for (size_t i = 0; i < Arms; i++) {
+                bool fresh = stamps[i] == epoch;
+                alphas[i] = fresh ? a[i] : KT_Alpha;
+                betas[i] = fresh ? b[i] : KT_Alpha;
+            }
+        }
+
+        // append the statistics to a snapshot, as by a non-rolling ActivePTW
+        // of the same shape, whose levels are all dense
+        void save(SnapshotWriter &out) const {
+            out.u64(Arms);
+            out.u64(0);
+            out.u64(Depth);
+            out.u64(m_index);
+
+            out.array(m_epochs.data(), Levels);
+            out.array(m_log_marginal.data(), Levels);
+            out.array(m_log_weighted.data(), Levels);
+            out.array(m_log_buf.data(), Levels);
+
+            for (size_t j = 0; j < Levels; j++) {
+                out.u64(0);
+                out.array(&m_alphas[j * Arms], Arms);
+                out.array(&m_betas[j * Arms], Arms);
+                out.array(&m_stamps[j * Arms], Arms);
+            }
+        }
+
+        // resume from the statistics of a model of the same shape, saved
+        // by this or a non-rolling ActivePTW
+        void restore(SnapshotReader &in) {
+            in.expect(Arms, "number of arms");
+            in.expect(0, "rolling flag");
+            in.expect(Depth, "PTW depth");
+
+            m_index = in.u64();
+            if (m_index > (static_cast<index_t>(1) << Depth)) {
+                die_with_error("snapshot holds a PTW model past its horizon.");
+            }
+
+            in.array(m_epochs.data(), Levels);
+            in.array(m_log_marginal.data(), Levels);
+            in.array(m_log_weighted.data(), Levels);
+            in.array(m_log_buf.data(), Levels);
+
+            for (size_t j = 0; j < Levels; j++) {
+                in.expect(0, "PTW level representation");
+                in.array(&m_alphas[j * Arms], Arms);
+                in.array(&m_betas[j * Arms], Arms);
+                in.array(&m_stamps[j * Arms], Arms);
+            }
+
+            m_level_posterior_stale = true;
+        }
+
+    private:
+
+        // recompute the level posterior and its sampler if stale
+        void refreshLevelPosterior() const {
+            if (!m_level_posterior_stale) return;
+
+            ActivePTW::computeLevelPosterior(
+                Depth, LogStopWeight, m_log_marginal.data(),
+                m_log_weighted.data(), m_level_posterior.data()
+            );
+
+            m_level_sampler.build(m_level_posterior);
+            m_level_posterior_stale = false;
+        }
+
+        index_t m_index = 0;
+
+        // per level and arm statistics, stored as [level][arm],
+        // lazily cleared using epoch tags as in ActivePTW
+        std::array<double, Levels * Arms> m_alphas;
+        std::array<double, Levels * Arms> m_betas;
+        std::array<uint64_t, Levels * Arms> m_stamps;
+
+        // per level statistics
+        std::array<uint64_t, Levels> m_epochs;
+        std::array<double, Levels> m_log_marginal;
+        std::array<double, Levels> m_log_weighted;
+        std::array<double, Levels> m_log_buf;
+
+        // cached level posterior, invalidated by each update
+        mutable std::vector<double> m_level_posterior;
+        mutable AliasTable m_level_sampler;
+        mutable bool m_level_posterior_stale = true;
+
+        // parameters to define the PTW prior, as in ActivePTW
+        double LogSplitWeight;
+        double LogStopWeight;
+
+        static constexpr double KT_Alpha = ActivePTW::KT_Alpha;
+};
+
+
+/* -------------------------------------------------------------------------- */
+
+
+#endif // __PTW_STATIC_HPP__
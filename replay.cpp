@@ -0,0 +1,179 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ==============================================================================
+
+#include "replay.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "common.hpp"
+
+
+/* -------------------------------------------------------------------------- */
+
+
+static const char PullLogMagic[8] = { 'E', 'B', 'C', 'R', 'P', 'U', 'L', 'L' };
+
+// written in native byte order, so a log of the other order is recognised
+static const uint32_t ByteOrderMarker = 0x01020304;
+
+// the size of the header, after which the records are 8 byte aligned
+static const size_t PullLogHeader = 24;
+
+// the number of pulls replayed as one chunk, of 4MB
+static const uint64_t ReplayChunk = 1 << 19;
+
+
+/* -------------------------------------------------------------------------- */
+
+
+PullLogWriter::PullLogWriter(const std::string &path, size_t arms) :
+    m_out(path, std::ios::binary | std::ios::trunc)
+{
+    if (!m_out) die_with_error("could not create pull log file.");
+
+    uint64_t n_arms = arms;
+    m_out.write(PullLogMagic, sizeof(PullLogMagic));
+    m_out.write(reinterpret_cast<const char *>(&PullLogVersion), 4);
+    m_out.write(reinterpret_cast<const char *>(&ByteOrderMarker), 4);
+    m_out.write(reinterpret_cast<const char *>(&n_arms), 8);
+}
+
+
+void PullLogWriter::append(const pull_t *pulls, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        logged_pull_t p = {
+            static_cast<uint32_t>(pulls[i].arm),
+            static_cast<uint32_t>(pulls[i].reward)
+        };
+        m_out.write(reinterpret_cast<const char *>(&p), sizeof(p));
+    }
+}
+
+
+bool PullLogWriter::close() {
+    m_out.close();
+
+    return !m_out.fail();
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+PullLog::PullLog(const std::string &path) :
+    m_file(path)
+{
+    const char *data = static_cast<const char *>(m_file.data());
+    size_t size = m_file.size();
+
+    if (size < PullLogHeader ||
+        std::memcmp(data, PullLogMagic, sizeof(PullLogMagic)) != 0) {
+        die_with_error("not a pull log file.");
+    }
+
+    uint32_t version, marker;
+    uint64_t arms;
+    std::memcpy(&version, data + 8, 4);
+    std::memcpy(&marker, data + 12, 4);
+    std::memcpy(&arms, data + 16, 8);
+
+    if (marker != ByteOrderMarker) {
+        die_with_error("pull log was written with another byte order.");
+    }
+    if (version != PullLogVersion) {
+        die_with_error("pull log is of an unsupported version.");
+    }
+    if ((size - PullLogHeader) % sizeof(logged_pull_t) != 0) {
+        die_with_error("pull log is truncated.");
+    }
+    if (arms < 2) die_with_error("pull log needs at least 2 arms.");
+
+    m_arms = static_cast<size_t>(arms);
+    m_size = (size - PullLogHeader) / sizeof(logged_pull_t);
+    m_pulls = reinterpret_cast<const logged_pull_t *>(data + PullLogHeader);
+}
+
+
+size_t PullLog::offset(uint64_t i) const {
+    return PullLogHeader + static_cast<size_t>(i) * sizeof(logged_pull_t);
+}
+
+
+void PullLog::willNeed(uint64_t first, uint64_t n) const {
+    m_file.willNeed(
+        offset(first), static_cast<size_t>(n) * sizeof(logged_pull_t)
+    );
+}
+
+
+void PullLog::doneWith(uint64_t first, uint64_t n) const {
+    m_file.doneWith(
+        offset(first), static_cast<size_t>(n) * sizeof(logged_pull_t)
+    );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+/* the replay method of Li et al., which discards the pulls the agent
+   disagrees with. each chunk's successor is read ahead while it is
+   replayed, and its predecessor's pages released, so memory use stays
+   bounded however long the log. */
+replay_result_t replayPullLog(BanditStrategy &agent, const PullLog &log) {
+    replay_result_t result = { log.size(), 0, 0.0, 0.0 };
+
+    auto start = std::chrono::steady_clock::now();
+
+    const logged_pull_t *pulls = log.pulls();
+    log.willNeed(0, ReplayChunk);
+
+    for (uint64_t first = 0; first < log.size(); first += ReplayChunk) {
+        uint64_t last = std::min(log.size(), first + ReplayChunk);
+
+        log.willNeed(last, ReplayChunk);
+        if (first > 0) log.doneWith(first - ReplayChunk, ReplayChunk);
+
+        for (uint64_t i = first; i < last; i++) {
+            const logged_pull_t &p = pulls[i];
+            if (p.arm >= log.arms() || p.reward > 1) {
+                die_with_error("pull log holds an invalid pull.");
+            }
+
+            size_t arm = agent.getAction();
+            if (arm != p.arm) continue;
+
+            agent.update(arm, static_cast<int>(p.reward));
+            result.accepted++;
+            result.reward += p.reward;
+        }
+    }
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    result.seconds = elapsed.count();
+
+    return result;
+}
+
+
+/* -------------------------------------------------------------------------- */
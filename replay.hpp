@@ -0,0 +1,120 @@
+#ifndef __REPLAY_HPP__
+#define __REPLAY_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include "bandits.hpp"
+#include "snapshot.hpp"
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// A binary log of bandit interactions, made to be streamed from a memory
+// mapping.
+//
+// a log is a 24 byte header, holding the magic "EBCRPULL", the format
+// version, a byte order marker and the number of arms, followed by one 8 byte
+// record per pull, holding the arm and the reward. the number of pulls is
+// implied by the file size, so a log can be appended to until it is closed.
+
+
+// the version written, and the only version read
+constexpr uint32_t PullLogVersion = 1;
+
+
+// a pull as recorded in a log
+struct logged_pull_t {
+    uint32_t arm;
+    uint32_t reward;
+};
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// writes a log, buffering its records
+class PullLogWriter {
+
+    public:
+
+        // a log of pulls of arms arms, dying with an error if the file
+        // cannot be created
+        PullLogWriter(const std::string &path, size_t arms);
+
+        // append n pulls
+        void append(const pull_t *pulls, size_t n);
+
+        // flush and close the log, returning false on failure
+        bool close();
+
+    private:
+
+        std::ofstream m_out;
+};
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// reads a log, dying with an error if it is not a log of this version and
+// byte order
+class PullLog {
+
+    public:
+
+        explicit PullLog(const std::string &path);
+
+        size_t arms() const { return m_arms; }
+
+        // the number of pulls
+        uint64_t size() const { return m_size; }
+
+        // the pulls, in place in the mapping
+        const logged_pull_t *pulls() const { return m_pulls; }
+
+        // advise that pulls [first, first+n) are about to be read, or that
+        // they have been and their memory may be reclaimed
+        void willNeed(uint64_t first, uint64_t n) const;
+        void doneWith(uint64_t first, uint64_t n) const;
+
+    private:
+
+        // the byte offset of a pull within the file
+        size_t offset(uint64_t i) const;
+
+        MappedFile m_file;
+        size_t m_arms;
+        uint64_t m_size;
+        const logged_pull_t *m_pulls;
+};
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// the outcome of a replay
+struct replay_result_t {
+    uint64_t pulls;     // the number of logged pulls replayed
+    uint64_t accepted;  // those whose arm the agent chose
+    double reward;      // the total reward of those accepted
+    double seconds;     // the wall clock time of the replay
+};
+
+
+// evaluate an agent offline by replay: for each logged pull, the agent
+// chooses an arm, and only if it chose the logged arm does it learn the
+// logged reward. for a log of pulls chosen uniformly at random, the average
+// reward of the accepted pulls is an unbiased estimate of the agent's
+// average reward online. the log is streamed in chunks, each read ahead of
+// its use and released after it
+replay_result_t replayPullLog(BanditStrategy &agent, const PullLog &log);
+
+
+/* -------------------------------------------------------------------------- */
+
+
+#endif // __REPLAY_HPP__
@@ -0,0 +1,263 @@
+#ifndef __RNG_HPP__
+#define __RNG_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// the family of pseudo random number generators available
+enum class RngKind { Xoshiro256pp, PCG64 };
+
+
+// parse the name of a generator family, returning false if unrecognised
+inline bool parseRngKind(const std::string &name, RngKind &kind) {
+    if (name == "xoshiro") {
+        kind = RngKind::Xoshiro256pp;
+    } else if (name == "pcg") {
+        kind = RngKind::PCG64;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// everything needed to reproducibly construct a generator. generators built
+// from the same seed but different streams produce non-overlapping sequences.
+struct rng_seed_t {
+
+    rng_seed_t(
+        uint64_t seed = 0,
+        uint64_t stream = 0,
+        RngKind kind = RngKind::Xoshiro256pp
+    ) :
+        seed(seed),
+        stream(stream),
+        kind(kind)
+    {
+    }
+
+    // a seed for an independent sub-generator, such as one owned by a
+    // component of a composite strategy, identified by i
+    rng_seed_t derive(uint64_t i) const {
+        uint64_t x = seed ^ ((i + 1) * 0x9e3779b97f4a7c15ULL);
+        return rng_seed_t(splitmix64(x), stream, kind);
+    }
+
+    // the SplitMix64 generator, used to expand seeds into full states
+    static uint64_t splitmix64(uint64_t &x) {
+        uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t seed;
+    uint64_t stream;
+    RngKind kind;
+};
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// a 64-bit uniform random bit generator, usable with the standard library
+// distributions, implementing either xoshiro256++ or PCG64 (XSL-RR 128/64).
+// the family is chosen at construction; a draw costs a single well
+// predicted branch to dispatch between them.
+class RandomEngine {
+
+    public:
+
+        typedef uint64_t result_type;
+
+        RandomEngine(const rng_seed_t &seed = rng_seed_t()) {
+            this->seed(seed);
+        }
+
+        // reinitialise the generator's state
+        void seed(const rng_seed_t &seed) {
+            m_kind = seed.kind;
+
+            uint64_t x = seed.seed;
+
+            if (m_kind == RngKind::Xoshiro256pp) {
+                for (size_t i = 0; i < 4; i++) {
+                    m_state[i] = rng_seed_t::splitmix64(x);
+                }
+
+                // each stream is 2^128 draws apart
+                for (uint64_t i = 0; i < seed.stream; i++) {
+                    jump();
+                }
+            } else {
+                // pcg streams are selected by the (odd) increment
+                uint64_t hi = rng_seed_t::splitmix64(x);
+                uint64_t lo = rng_seed_t::splitmix64(x);
+                m_state[0] = 0; m_state[1] = 0;
+                m_state[2] = seed.stream >> 63;
+                m_state[3] = (seed.stream << 1) | 1;
+                pcgStep();
+                pcgAdd(m_state[0], m_state[1], hi, lo);
+                pcgStep();
+            }
+        }
+
+        static constexpr result_type min() { return 0; }
+        static constexpr result_type max() {
+            return std::numeric_limits<result_type>::max();
+        }
+
+        // the next 64 random bits
+        result_type operator()() {
+            if (m_kind == RngKind::Xoshiro256pp) {
+                return xoshiroNext();
+            }
+
+            return pcgNext();
+        }
+
+        // a uniform double in [0, 1), using the top 53 bits of a draw
+        double uniform() {
+            return static_cast<double>((*this)() >> 11) * 0x1.0p-53;
+        }
+
+        // a uniform integer in [0, n), for n > 0, as the high word of a
+        // draw times n, rejecting the few draws which would bias it
+        // (Lemire's method), so usually without a division
+        uint64_t below(uint64_t n) {
+            uint64_t hi, lo;
+            mul128((*this)(), n, hi, lo);
+
+            if (lo < n) {
+                uint64_t threshold = (0 - n) % n;
+                while (lo < threshold) mul128((*this)(), n, hi, lo);
+            }
+
+            return hi;
+        }
+
+        // advance a xoshiro256++ generator by 2^128 draws
+        void jump();
+
+        // the family and raw state of the generator, e.g. to checkpoint it
+        RngKind kind() const { return m_kind; }
+        const uint64_t *state() const { return m_state; }
+
+        // resume from a state previously read by kind() and state()
+        void setState(RngKind kind, const uint64_t *state) {
+            m_kind = kind;
+            for (size_t i = 0; i < 4; i++) m_state[i] = state[i];
+        }
+
+    private:
+
+        static uint64_t rotl(uint64_t x, int k) {
+            return (x << k) | (x >> (64 - k));
+        }
+
+        static uint64_t rotr(uint64_t x, unsigned int k) {
+            return (x >> k) | (x << ((64 - k) & 63));
+        }
+
+        uint64_t xoshiroNext() {
+            const uint64_t result =
+                rotl(m_state[0] + m_state[3], 23) + m_state[0];
+            const uint64_t t = m_state[1] << 17;
+
+            m_state[2] ^= m_state[0];
+            m_state[3] ^= m_state[1];
+            m_state[1] ^= m_state[2];
+            m_state[0] ^= m_state[3];
+            m_state[2] ^= t;
+            m_state[3] = rotl(m_state[3], 45);
+
+            return result;
+        }
+
+        // the 64x64 -> 128 bit product (hi, lo) = a * b, done portably
+        static void mul128(uint64_t a, uint64_t b, uint64_t &hi, uint64_t &lo) {
+            uint64_t a0 = a & 0xffffffffULL, a1 = a >> 32;
+            uint64_t b0 = b & 0xffffffffULL, b1 = b >> 32;
+            uint64_t p00 = a0 * b0, p01 = a0 * b1;
+            uint64_t p10 = a1 * b0, p11 = a1 * b1;
+            uint64_t mid = (p00 >> 32) + (p01 & 0xffffffffULL) +
+                (p10 & 0xffffffffULL);
+
+            lo = (mid << 32) | (p00 & 0xffffffffULL);
+            hi = p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+        }
+
+        // 128-bit addition, (hi, lo) += (b_hi, b_lo)
+        static void pcgAdd(
+            uint64_t &hi, uint64_t &lo,
+            uint64_t b_hi, uint64_t b_lo
+        ) {
+            lo += b_lo;
+            hi += b_hi + (lo < b_lo ? 1 : 0);
+        }
+
+        // state = state * multiplier + increment, modulo 2^128
+        void pcgStep() {
+            const uint64_t mul_hi = 0x2360ed051fc65da4ULL;
+            const uint64_t mul_lo = 0x4385df649fccf645ULL;
+
+            uint64_t hi = m_state[0], lo = m_state[1];
+
+            // the low product, then the cross terms of the high word
+            uint64_t prod_hi, prod_lo;
+            mul128(lo, mul_lo, prod_hi, prod_lo);
+
+            prod_hi += hi * mul_lo + lo * mul_hi;
+
+            m_state[0] = prod_hi;
+            m_state[1] = prod_lo;
+            pcgAdd(m_state[0], m_state[1], m_state[2], m_state[3]);
+        }
+
+        uint64_t pcgNext() {
+            pcgStep();
+            uint64_t hi = m_state[0], lo = m_state[1];
+            return rotr(hi ^ lo, static_cast<unsigned int>(hi >> 58));
+        }
+
+        // xoshiro256++ uses all four words; PCG64 stores its 128-bit
+        // state in words 0-1 and its 128-bit increment in words 2-3
+        uint64_t m_state[4];
+        RngKind m_kind;
+};
+
+
+inline void RandomEngine::jump() {
+    static const uint64_t Jump[] = {
+        0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+        0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL
+    };
+
+    uint64_t s[4] = { 0, 0, 0, 0 };
+    for (size_t i = 0; i < 4; i++) {
+        for (int b = 0; b < 64; b++) {
+            if (Jump[i] & (static_cast<uint64_t>(1) << b)) {
+                for (size_t j = 0; j < 4; j++) s[j] ^= m_state[j];
+            }
+            xoshiroNext();
+        }
+    }
+
+    for (size_t j = 0; j < 4; j++) m_state[j] = s[j];
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+#endif // __RNG_HPP__
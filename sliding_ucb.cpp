@@ -15,98 +15,172 @@
 
 #include "sliding_ucb.hpp"
 
+#include <cassert>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <algorithm>
 #include <limits>
-#include <random>
 #include <vector>
 
+#include "snapshot.hpp"
+
 
 /* -------------------------------------------------------------------------- */
 
 
 SlidingUCBStrategy::SlidingUCBStrategy(
-    unsigned int seed,
+    const rng_seed_t &seed,
     size_t n_arms,
     size_t window
 ) :
     m_generator(seed),
     m_arms(n_arms),
     m_window(window),
+    m_oldest(0),
     m_arm_cumm_reward(n_arms, 0.0),
-    m_arm_visits(n_arms, 0.0)
+    m_arm_visits(n_arms, 0.0),
+    m_unvisited(n_arms, true),
+    m_bounds(n_arms),
+    m_horizon(0),
+    m_horizon_log_term(0.0)
 {
+    assert(m_window >= 1);
 }
 
 
 void SlidingUCBStrategy::reset() {
     m_plays.clear();
-    m_rewards.clear();
+    m_oldest = 0;
     m_arm_cumm_reward = std::vector<double>(m_arms, 0.0);
     m_arm_visits = std::vector<double>(m_arms, 0.0);
+    m_unvisited.reset(m_arms, true);
+    m_bounds.resize(m_arms);
+    m_horizon = 0;
 }
 
 
 size_t SlidingUCBStrategy::getAction() {
-    auto unvisited = unvisitedArms();
-
     // if we have any unvisited arms, pick one uniformly at random
-    if (!unvisited.empty()) {
-        std::uniform_int_distribution<size_t> randidx(0, unvisited.size()-1);
-        return unvisited[randidx(m_generator)];
+    if (!m_unvisited.empty()) {
+        return m_unvisited.select(m_generator.below(m_unvisited.size()));
     }
 
-    // ...otherwise pick the arm with the maximising UCB score
-    double best = -std::numeric_limits<double>::infinity();
-    size_t best_idx = 0;
+    if (m_plays.size() > m_horizon) rebuildBounds();
 
-    for (size_t i = 0; i < m_arms; i++) {
-        double score = ucb(i);
-        if (score > best) {
-            best = score;
-            best_idx = i;
-        }
-    }
+    double log_term = 2.0 * std::log(m_plays.size());
 
-    return best_idx;
+    // ...otherwise pick the arm with the maximising UCB score
+    return m_bounds.argmax([&](size_t i) { return ucb(i, log_term); });
 }
 
 
 void SlidingUCBStrategy::update(size_t arm, int reward) {
-    m_plays.push_back(arm);
-    m_rewards.push_back(reward);
+    assert(reward == 0 || reward == 1);
+
+    uint64_t play = static_cast<uint64_t>(arm) << 1 | (reward ? 1 : 0);
+
     m_arm_cumm_reward[arm] += reward;
     m_arm_visits[arm] += 1.0;
 
-    if (m_plays.size() > m_window) {
-        m_arm_visits[m_plays.front()] -= 1.0;
-        m_arm_cumm_reward[m_plays.front()] -= m_rewards.front();
-
-        m_plays.pop_front();
-        m_rewards.pop_front();
+    if (m_plays.size() < m_window) {
+        m_plays.push_back(play);
+        touch(arm);
+        return;
     }
+
+    // the window is full, so the oldest play is evicted in favour of this one
+    uint64_t oldest = m_plays[m_oldest];
+    size_t old_arm = static_cast<size_t>(oldest >> 1);
+
+    m_arm_visits[old_arm] -= 1.0;
+    m_arm_cumm_reward[old_arm] -= static_cast<double>(oldest & 1);
+
+    m_plays[m_oldest] = play;
+    m_oldest = m_oldest + 1 == m_window ? 0 : m_oldest + 1;
+
+    touch(arm);
+    touch(old_arm);
 }
 
 
-std::vector<size_t> SlidingUCBStrategy::unvisitedArms() const {
-    std::vector<size_t> rval;
+void SlidingUCBStrategy::touch(size_t arm) {
+    UpperBoundTree::stats_t stats(m_arm_cumm_reward[arm], m_arm_visits[arm]);
 
-    for (size_t arm=0; arm < m_arms; arm++) {
-        if (m_arm_visits[arm] == 0.0)
-            rval.emplace_back(arm);
+    if (m_arm_visits[arm] == 0.0) {
+        m_unvisited.insert(arm);
+        m_bounds.set(arm, stats, UpperBoundTree::Infinity);
+        return;
     }
 
-    return rval;
+    // bounds past their horizon are rebuilt before the next use
+    m_unvisited.erase(arm);
+    double bound = UpperBoundTree::Infinity;
+    if (m_plays.size() <= m_horizon) bound = ucb(arm, m_horizon_log_term);
+
+    m_bounds.set(arm, stats, bound);
 }
 
 
-double SlidingUCBStrategy::ucb(size_t arm) const {
+void SlidingUCBStrategy::rebuildBounds() {
+    double horizon = boundHorizon(static_cast<double>(m_plays.size()));
+    m_horizon = std::min(m_window, static_cast<size_t>(horizon));
+    m_horizon_log_term = 2.0 * std::log(m_horizon);
+
+    m_bounds.rebuild([&](size_t i) {
+        if (m_arm_visits[i] == 0.0) return UpperBoundTree::Infinity;
+        return ucb(i, m_horizon_log_term);
+    });
+}
+
+
+void SlidingUCBStrategy::save(SnapshotWriter &out) const {
+    out.str(name());
+    out.u64(m_arms);
+    out.u64(m_window);
+    out.rng(m_generator);
+    out.array(m_plays);
+    out.u64(m_oldest);
+    out.array(m_arm_cumm_reward);
+    out.array(m_arm_visits);
+    out.u64(m_horizon);
+    out.f64(m_horizon_log_term);
+
+    std::vector<double> bounds(m_arms);
+    for (size_t i = 0; i < m_arms; i++) bounds[i] = m_bounds.bound(i);
+    out.array(bounds);
+}
+
+
+void SlidingUCBStrategy::restore(SnapshotReader &in) {
+    in.expect(name());
+    in.expect(m_arms, "number of arms");
+    in.expect(m_window, "window size");
+    in.rng(m_generator);
+    in.array(m_plays);
+    m_oldest = static_cast<size_t>(in.u64());
+    in.array(m_arm_cumm_reward.data(), m_arms);
+    in.array(m_arm_visits.data(), m_arms);
+    m_horizon = static_cast<size_t>(in.u64());
+    m_horizon_log_term = in.f64();
+
+    const double *bounds = in.view<double>(m_arms);
+
+    m_unvisited.reset(m_arms, false);
+    m_bounds.resize(m_arms);
+    for (size_t i = 0; i < m_arms; i++) {
+        if (m_arm_visits[i] == 0.0) m_unvisited.insert(i);
+        m_bounds.set(i, {m_arm_cumm_reward[i], m_arm_visits[i]}, bounds[i]);
+    }
+}
+
+
+double SlidingUCBStrategy::ucb(size_t arm, double log_term) const {
     double mean = m_arm_cumm_reward[arm] / m_arm_visits[arm];
-    double ci = std::sqrt((2.0 * std::log(m_plays.size())) / m_arm_visits[arm]);
+    double ci = std::sqrt(log_term / m_arm_visits[arm]);
 
     return mean + ci;
 }
 
 
 /* -------------------------------------------------------------------------- */
-
@@ -2,12 +2,14 @@
 #define __SLIDING_UCB_HPP__
 
 #include <cstddef>
-#include <deque>
+#include <cstdint>
 #include <random>
 #include <string>
 #include <vector>
 
 #include "bandits.hpp"
+#include "index.hpp"
+#include "rng.hpp"
 
 
 /* -------------------------------------------------------------------------- */
@@ -20,7 +22,7 @@ class SlidingUCBStrategy : public BanditStrategy {
     public:
 
         // SlidingWindow-UCB for a given window size
-        SlidingUCBStrategy(unsigned int seed, size_t n_arms, size_t window);
+        SlidingUCBStrategy(const rng_seed_t &seed, size_t n_arms, size_t window);
 
         // implement a UCB policy
         size_t getAction() override;
@@ -30,28 +32,55 @@ class SlidingUCBStrategy : public BanditStrategy {
 
         std::string name() const override { return "SlidingUCB"; }
 
+        void save(SnapshotWriter &out) const override;
+
+        // restores the window and the bounds as they were, and fails
+        // unless the window size is the same
+        void restore(SnapshotReader &in) override;
+
         // resets the mean/visit statistics
         void reset();
 
     private:
 
-        // gives a vector of unvisited arms
-        std::vector<size_t> unvisitedArms() const;
+        // windowed UCB score of a given arm, where log_term is twice the
+        // log of the number of plays in the window
+        double ucb(size_t arm, double log_term) const;
+
+        // record a change in the statistics of an arm
+        void touch(size_t arm);
 
-        // windowed UCB score of a given arm
-        double ucb(size_t arm) const;
+        // bound every arm's score until a new horizon
+        void rebuildBounds();
 
         // limited amount of randomness used in this implementation
         // so that the "play each arm once" step is done according
         // to a random permutation of the arm indices
-        mutable std::default_random_engine m_generator;
+        mutable RandomEngine m_generator;
 
         size_t m_arms;
         size_t m_window;
-        std::deque<size_t> m_plays;
-        std::deque<double> m_rewards;
+
+        // the plays in the window, each packed as arm << 1 | reward. this
+        // grows to at most the window size, then is used as a ring buffer
+        // whose oldest entry is at m_oldest
+        std::vector<uint64_t> m_plays;
+        size_t m_oldest;
+
         std::vector<double> m_arm_cumm_reward;
         std::vector<double> m_arm_visits;
+
+        // the arms with no plays in the window
+        RankSet m_unvisited;
+
+        // each arm's score once the window holds m_horizon plays, which
+        // bounds its score until then, as the exploration bonus grows with
+        // the number of plays. once the window is full the horizon is the
+        // window, so the bounds are exact and only the played and evicted
+        // arms change each step
+        UpperBoundTree m_bounds;
+        size_t m_horizon;
+        double m_horizon_log_term;
 };
 
 
@@ -0,0 +1,278 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ==============================================================================
+
+#include "snapshot.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if defined(__has_include)
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SNAPSHOT_MMAP 1
+#endif
+#endif
+
+#include "common.hpp"
+
+
+/* -------------------------------------------------------------------------- */
+
+
+static const char SnapshotMagic[8] = { 'E', 'B', 'C', 'R', 'S', 'N', 'A', 'P' };
+
+// reads back as another value on a machine of the opposite byte order
+static const uint32_t ByteOrderMarker = 0x01020304;
+
+
+/* -------------------------------------------------------------------------- */
+
+
+SnapshotWriter::SnapshotWriter() {
+    append(SnapshotMagic, sizeof(SnapshotMagic));
+    append(&SnapshotVersion, sizeof(SnapshotVersion));
+    append(&ByteOrderMarker, sizeof(ByteOrderMarker));
+}
+
+
+void SnapshotWriter::append(const void *data, size_t n) {
+    const char *p = static_cast<const char *>(data);
+    m_bytes.insert(m_bytes.end(), p, p + n);
+}
+
+
+void SnapshotWriter::u64(uint64_t x) {
+    append(&x, sizeof(x));
+}
+
+
+void SnapshotWriter::f64(double x) {
+    append(&x, sizeof(x));
+}
+
+
+void SnapshotWriter::str(const std::string &s) {
+    u64(s.size());
+    append(s.data(), s.size());
+    m_bytes.resize(m_bytes.size() + (8 - s.size() % 8) % 8, '\0');
+}
+
+
+void SnapshotWriter::rng(const RandomEngine &generator) {
+    u64(static_cast<uint64_t>(generator.kind()));
+    array(generator.state(), 4);
+}
+
+
+bool SnapshotWriter::writeFile(const std::string &path) const {
+    std::ofstream out(path, std::ios::binary);
+    out.write(m_bytes.data(), static_cast<std::streamsize>(m_bytes.size()));
+
+    return static_cast<bool>(out);
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+SnapshotReader::SnapshotReader(const void *data, size_t size) :
+    m_data(static_cast<const char *>(data)),
+    m_size(size),
+    m_pos(0)
+{
+    const char *magic = static_cast<const char *>(take(sizeof(SnapshotMagic)));
+    if (std::memcmp(magic, SnapshotMagic, sizeof(SnapshotMagic)) != 0) {
+        die_with_error("snapshot is not a snapshot.");
+    }
+
+    uint32_t version, marker;
+    std::memcpy(&version, take(sizeof(version)), sizeof(version));
+    std::memcpy(&marker, take(sizeof(marker)), sizeof(marker));
+
+    if (marker != ByteOrderMarker) {
+        die_with_error("snapshot was written with another byte order.");
+    }
+    if (version != SnapshotVersion) {
+        die_with_error("snapshot has an unsupported version.");
+    }
+}
+
+
+const void *SnapshotReader::take(size_t n) {
+    if (n > m_size - m_pos) die_with_error("snapshot is truncated.");
+
+    const char *p = m_data + m_pos;
+    m_pos += n;
+
+    return p;
+}
+
+
+const void *SnapshotReader::takeArray(uint64_t n, size_t size) {
+    if (n > (m_size - m_pos) / size) die_with_error("snapshot is truncated.");
+
+    return take(static_cast<size_t>(n) * size);
+}
+
+
+void SnapshotReader::mismatch(const std::string &what) const {
+    die_with_error(("snapshot holds " + what + ".").c_str());
+    std::abort();
+}
+
+
+uint64_t SnapshotReader::u64() {
+    uint64_t x;
+    std::memcpy(&x, take(sizeof(x)), sizeof(x));
+
+    return x;
+}
+
+
+double SnapshotReader::f64() {
+    double x;
+    std::memcpy(&x, take(sizeof(x)), sizeof(x));
+
+    return x;
+}
+
+
+std::string SnapshotReader::str() {
+    uint64_t n = u64();
+    const char *chars = static_cast<const char *>(takeArray(n, 1));
+
+    std::string s(chars, static_cast<size_t>(n));
+    take((8 - n % 8) % 8);
+
+    return s;
+}
+
+
+void SnapshotReader::rng(RandomEngine &generator) {
+    uint64_t kind = u64();
+    if (kind > static_cast<uint64_t>(RngKind::PCG64)) {
+        mismatch("an unknown generator");
+    }
+
+    uint64_t state[4];
+    array(state, 4);
+    generator.setState(static_cast<RngKind>(kind), state);
+}
+
+
+void SnapshotReader::expect(const std::string &name) {
+    std::string found = str();
+    if (found != name) mismatch("the state of " + found + ", not " + name);
+}
+
+
+void SnapshotReader::expect(uint64_t x, const char *what) {
+    if (u64() != x) mismatch(std::string("a different ") + what);
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+MappedFile::MappedFile(const std::string &path) :
+    m_data(nullptr),
+    m_size(0),
+    m_mapped(false)
+{
+#ifdef SNAPSHOT_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+
+    if (fd >= 0 && ::fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *p = ::mmap(
+            nullptr, static_cast<size_t>(st.st_size),
+            PROT_READ, MAP_PRIVATE, fd, 0
+        );
+        if (p != MAP_FAILED) {
+            m_data = p;
+            m_size = static_cast<size_t>(st.st_size);
+            m_mapped = true;
+        }
+    }
+    if (fd >= 0) ::close(fd);
+
+    if (m_mapped) return;
+#endif
+
+    // read into 8 byte words, so the arrays are as aligned as when mapped
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) die_with_error("could not read file.");
+
+    m_size = static_cast<size_t>(in.tellg());
+    m_buffer.resize((m_size + 7) / 8);
+    in.seekg(0);
+    in.read(reinterpret_cast<char *>(m_buffer.data()),
+        static_cast<std::streamsize>(m_size));
+    if (!in) die_with_error("could not read file.");
+
+    m_data = m_buffer.data();
+}
+
+
+MappedFile::~MappedFile() {
+#ifdef SNAPSHOT_MMAP
+    if (m_mapped) ::munmap(const_cast<void *>(m_data), m_size);
+#endif
+}
+
+
+#ifdef SNAPSHOT_MMAP
+void MappedFile::willNeed(size_t offset, size_t n) const {
+    advise(offset, n, MADV_WILLNEED);
+}
+
+
+void MappedFile::doneWith(size_t offset, size_t n) const {
+    advise(offset, n, MADV_DONTNEED);
+}
+
+
+/* advice applies to whole pages, so the range is widened to page bounds,
+   which the mapping itself starts on. advice is only a hint, so failure is
+   ignored. */
+void MappedFile::advise(size_t offset, size_t n, int advice) const {
+    if (!m_mapped || offset >= m_size) return;
+
+    static const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+
+    size_t first = offset / page * page;
+    size_t last = std::min(offset + n, m_size);
+    if (last <= first) return;
+
+    char *base = static_cast<char *>(const_cast<void *>(m_data));
+    ::madvise(base + first, last - first, advice);
+}
+#else
+void MappedFile::willNeed(size_t, size_t) const { }
+void MappedFile::doneWith(size_t, size_t) const { }
+void MappedFile::advise(size_t, size_t, int) const { }
+#endif
+
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,200 @@
+#ifndef __SNAPSHOT_HPP__
+#define __SNAPSHOT_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "rng.hpp"
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// A versioned binary image of strategy state.
+//
+// an image is a 16 byte header, holding the magic "EBCRSNAP", the format
+// version and a byte order marker, followed by each strategy's record: its
+// name, then its fields in a fixed order. every field occupies a multiple of
+// 8 bytes, so the flat arrays holding the bulk of a model, such as the PTW
+// statistics, are 8 byte aligned within the image and can be read straight
+// out of a memory mapping of it.
+
+
+// the version written, and the only version read
+constexpr uint32_t SnapshotVersion = 3;
+
+
+// whether values of type T can be held in a snapshot array
+template<class T>
+struct snapshot_field {
+    static constexpr bool value =
+        sizeof(T) == 8 && std::is_trivially_copyable<T>::value;
+};
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// builds an image in memory
+class SnapshotWriter {
+
+    public:
+
+        // an image holding just the header
+        SnapshotWriter();
+
+        void u64(uint64_t x);
+        void f64(double x);
+
+        // a length, then the characters, padded to a multiple of 8 bytes
+        void str(const std::string &s);
+
+        // a length, then the elements, each of which is 8 bytes
+        template<class T>
+        void array(const T *data, size_t n) {
+            static_assert(snapshot_field<T>::value, "not a snapshot field");
+
+            u64(n);
+            append(data, n * sizeof(T));
+        }
+
+        template<class T>
+        void array(const std::vector<T> &v) { array(v.data(), v.size()); }
+
+        // the kind and raw state of a generator
+        void rng(const RandomEngine &generator);
+
+        // the image so far
+        const std::vector<char> &bytes() const { return m_bytes; }
+
+        // write the image to a file, returning false on failure
+        bool writeFile(const std::string &path) const;
+
+    private:
+
+        void append(const void *data, size_t n);
+
+        std::vector<char> m_bytes;
+};
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// reads the fields of an image in the order they were written, dying with
+// an error if the image is truncated, of another version or byte order, or
+// describes a strategy other than the one restoring from it
+class SnapshotReader {
+
+    public:
+
+        // a view of an image, which must outlive the reader
+        SnapshotReader(const void *data, size_t size);
+
+        uint64_t u64();
+        double f64();
+        std::string str();
+
+        // an array of exactly n elements, read in place
+        template<class T>
+        const T *view(size_t n) {
+            static_assert(snapshot_field<T>::value, "not a snapshot field");
+
+            if (u64() != n) mismatch("an array of the wrong length");
+            return static_cast<const T *>(takeArray(n, sizeof(T)));
+        }
+
+        // an array of any length, copied into v
+        template<class T>
+        void array(std::vector<T> &v) {
+            static_assert(snapshot_field<T>::value, "not a snapshot field");
+
+            // the length is checked against the image before it is trusted
+            uint64_t n = u64();
+            const void *src = takeArray(n, sizeof(T));
+            v.resize(static_cast<size_t>(n));
+            if (n > 0) std::memcpy(v.data(), src, v.size() * sizeof(T));
+        }
+
+        // an array of exactly n elements, copied into data
+        template<class T>
+        void array(T *data, size_t n) {
+            const T *src = view<T>(n);
+            if (n > 0) std::memcpy(data, src, n * sizeof(T));
+        }
+
+        // restore a generator saved by SnapshotWriter::rng
+        void rng(RandomEngine &generator);
+
+        // the start of a record, which must be for the named strategy
+        void expect(const std::string &name);
+
+        // a field which must equal the value of the restoring strategy
+        void expect(uint64_t x, const char *what);
+
+        // whether the whole image has been read
+        bool done() const { return m_pos == m_size; }
+
+    private:
+
+        const void *take(size_t n);
+
+        // n elements of the given size, without overflowing their length
+        const void *takeArray(uint64_t n, size_t size);
+
+        [[noreturn]] void mismatch(const std::string &what) const;
+
+        const char *m_data;
+        size_t m_size;
+        size_t m_pos;
+};
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// a read only view of a whole file, memory mapped where the platform allows
+// it, and otherwise read into memory
+class MappedFile {
+
+    public:
+
+        // dies with an error if the file cannot be read
+        explicit MappedFile(const std::string &path);
+
+        ~MappedFile();
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        const void *data() const { return m_data; }
+        size_t size() const { return m_size; }
+
+        // advise that bytes [offset, offset+n) are about to be read, or that
+        // they have been and their pages may be dropped; they are reread
+        // from the file if used again. both do nothing when not mapped
+        void willNeed(size_t offset, size_t n) const;
+        void doneWith(size_t offset, size_t n) const;
+
+    private:
+
+        // the pages covering bytes [offset, offset+n), if mapped
+        void advise(size_t offset, size_t n, int advice) const;
+
+        const void *m_data;
+        size_t m_size;
+        bool m_mapped;
+
+        // the contents, when not mapped
+        std::vector<uint64_t> m_buffer;
+};
+
+
+/* -------------------------------------------------------------------------- */
+
+
+#endif // __SNAPSHOT_HPP__
@@ -0,0 +1,96 @@
+#ifndef __STATS_HPP__
+#define __STATS_HPP__
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// online estimates of the mean and variance of a fixed length sequence of
+// random variables, such as a regret curve, accumulated one sample curve at
+// a time using Welford's algorithm, so memory is independent of the number
+// of samples
+class RunningStats {
+
+    public:
+
+        RunningStats(size_t length = 0) :
+            m_n(0),
+            m_mean(length, 0.0),
+            m_m2(length, 0.0)
+        {
+        }
+
+        // incorporate one sample of every variable in the sequence
+        void add(const std::vector<double> &x) {
+            assert(x.size() == m_mean.size());
+
+            m_n++;
+            double n = static_cast<double>(m_n);
+
+            for (size_t t = 0; t < x.size(); t++) {
+                double delta = x[t] - m_mean[t];
+                m_mean[t] += delta / n;
+                m_m2[t] += delta * (x[t] - m_mean[t]);
+            }
+        }
+
+        // incorporate the samples accumulated by another instance,
+        // using the pairwise update of Chan et al.
+        void merge(const RunningStats &o) {
+            assert(o.m_mean.size() == m_mean.size());
+
+            if (o.m_n == 0) return;
+
+            double na = static_cast<double>(m_n);
+            double nb = static_cast<double>(o.m_n);
+            double n = na + nb;
+
+            for (size_t t = 0; t < m_mean.size(); t++) {
+                double delta = o.m_mean[t] - m_mean[t];
+                m_mean[t] += delta * nb / n;
+                m_m2[t] += o.m_m2[t] + delta * delta * na * nb / n;
+            }
+
+            m_n += o.m_n;
+        }
+
+        // the number of samples accumulated
+        size_t count() const { return m_n; }
+
+        // the length of the sequence
+        size_t length() const { return m_mean.size(); }
+
+        // the sample mean of the t'th variable
+        double mean(size_t t) const { return m_mean[t]; }
+
+        // the unbiased sample variance of the t'th variable
+        double variance(size_t t) const {
+            return m_n > 1 ? m_m2[t] / static_cast<double>(m_n - 1) : 0.0;
+        }
+
+        // the half width of a normal approximation confidence interval for
+        // the mean of the t'th variable, 95% by default
+        double confidence(size_t t, double z = 1.96) const {
+            if (m_n == 0) return 0.0;
+
+            double n = static_cast<double>(m_n);
+            return z * std::sqrt(variance(t) / n);
+        }
+
+    private:
+
+        size_t m_n;
+        std::vector<double> m_mean;
+        std::vector<double> m_m2;
+};
+
+
+/* -------------------------------------------------------------------------- */
+
+
+#endif // __STATS_HPP__
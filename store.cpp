@@ -0,0 +1,284 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ==============================================================================
+
+#include "store.hpp"
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+#include "beta.hpp"
+#include "common.hpp"
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// the stamp of an arm not yet touched by an instance, which no epoch reaches
+static const uint64_t Untouched = ~static_cast<uint64_t>(0);
+
+
+/* -------------------------------------------------------------------------- */
+
+
+ActivePTWStore::ActivePTWStore(
+    size_t depth,
+    size_t arms,
+    double log_precision
+) :
+    m_depth(depth),
+    m_arms(arms),
+    m_levels(depth + 1),
+    m_fast_log(log_precision > 0.0 ?
+        &LogAddTable::forPrecision(log_precision) : nullptr),
+    m_real_stride(2 * (depth + 1) * arms + 3 * (depth + 1)),
+    m_tag_stride((depth + 1) * arms + (depth + 1) + 1),
+    m_slots(0)
+{
+    ActivePTW::priorWeights(arms, LogStopWeight, LogSplitWeight);
+
+    assert(m_depth >= 1 && m_depth < 64);
+}
+
+
+void ActivePTWStore::reserve(size_t n) {
+    if (n <= m_slots) return;
+
+    m_reals.resize(n * m_real_stride);
+    m_tags.resize(n * m_tag_stride);
+    for (size_t s = n; s > m_slots; s--) m_free.push_back(s - 1);
+    m_slots = n;
+}
+
+
+void ActivePTWStore::create(id_t id) {
+    if (contains(id)) die_with_error("store already holds the instance.");
+
+    // grow the arena geometrically, so creation is amortized O(stride)
+    if (m_free.empty()) reserve(std::max<size_t>(2 * m_slots, 64));
+
+    size_t slot = m_free.back();
+    m_free.pop_back();
+    m_ids.emplace(id, slot);
+
+    // every arm is at the KT prior until touched, so only the tags and the
+    // per level statistics need clearing
+    size_t cells = m_levels * m_arms;
+    double *r = reals(slot);
+    uint64_t *t = tags(slot);
+
+    std::fill(r + 2 * cells, r + m_real_stride, 0.0);
+    std::fill(t, t + cells, Untouched);
+    std::fill(t + cells, t + m_tag_stride, 0);
+}
+
+
+void ActivePTWStore::evict(id_t id) {
+    auto it = m_ids.find(id);
+    if (it == m_ids.end()) die_with_error("store holds no such instance.");
+
+    m_free.push_back(it->second);
+    m_ids.erase(it);
+}
+
+
+size_t ActivePTWStore::find(id_t id) const {
+    auto it = m_ids.find(id);
+    if (it == m_ids.end()) die_with_error("store holds no such instance.");
+
+    return it->second;
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+/* the update of ActivePTW, over the dense layout of a slot. */
+void ActivePTWStore::apply(size_t slot, size_t arm, int reward) {
+    assert(arm < m_arms);
+
+    size_t cells = m_levels * m_arms;
+    double *alphas = reals(slot);
+    double *betas = alphas + cells;
+    double *log_marginal = betas + cells;
+    double *log_weighted = log_marginal + m_levels;
+    double *log_buf = log_weighted + m_levels;
+
+    uint64_t *stamps = tags(slot);
+    uint64_t *epochs = stamps + cells;
+    uint64_t &index = epochs[m_levels];
+
+    assert(index < (static_cast<index_t>(1) << m_depth));
+
+    // mscb requires the current 1-based time
+    size_t i = ActivePTW::mscb(index + 1, m_depth);
+
+    // save weighted probability in change point's parent
+    log_buf[i] = log_weighted[i + 1];
+
+    // now reset statistics from the change point downwards
+    ActivePTW::resetLevels(
+        i + 1, m_depth, epochs, log_marginal, log_weighted, log_buf
+    );
+
+    // update the KT estimator of the arm at every level
+    for (size_t j = 0; j <= m_depth; j++) {
+        size_t s = j * m_arms + arm;
+
+        if (stamps[s] != epochs[j]) {
+            alphas[s] = KT_Alpha;
+            betas[s] = KT_Alpha;
+            stamps[s] = epochs[j];
+        }
+
+        ActivePTW::countKT(
+            reward, alphas[s], betas[s], log_marginal[j], m_fast_log
+        );
+    }
+
+    ActivePTW::weigh(
+        m_depth, LogStopWeight, LogSplitWeight, log_marginal, log_buf,
+        log_weighted, m_fast_log
+    );
+
+    index++;
+}
+
+
+void ActivePTWStore::update(id_t id, size_t arm, int reward) {
+    apply(find(id), arm, reward);
+}
+
+
+/* consecutive pulls by the same instance, as when a batch is grouped by
+   instance, look up its slot once. */
+void ActivePTWStore::updateBatch(const keyed_pull_t *pulls, size_t n) {
+    size_t slot = 0;
+
+    for (size_t k = 0; k < n; k++) {
+        if (k == 0 || pulls[k].id != pulls[k - 1].id) slot = find(pulls[k].id);
+        apply(slot, pulls[k].arm, pulls[k].reward);
+    }
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+
+/* as for ActivePTWBanditStrategy, sample a level from its posterior, then
+   take the argmax of a beta sample from each arm's posterior there. */
+size_t ActivePTWStore::getAction(id_t id, worker_t &worker) const {
+    size_t slot = find(id);
+
+    levelPosteriorOf(slot, worker.posterior);
+
+    double total = 0.0;
+    for (double p : worker.posterior) total += p;
+
+    double u = worker.generator.uniform() * total;
+    size_t level = m_depth;
+    for (size_t j = 0; j < m_depth; j++) {
+        if (u < worker.posterior[j]) {
+            level = j;
+            break;
+        }
+        u -= worker.posterior[j];
+    }
+
+    worker.alphas.resize(m_arms);
+    worker.betas.resize(m_arms);
+    posteriorsOf(slot, level, worker.alphas.data(), worker.betas.data());
+
+    // the samples overwrite the gathered alphas, as in ActivePTW
+    betaSamples(
+        worker.generator, worker.alphas.data(), worker.betas.data(),
+        worker.alphas.data(), m_arms
+    );
+
+    return std::distance(
+        worker.alphas.begin(),
+        std::max_element(worker.alphas.begin(), worker.alphas.end())
+    );
+}
+
+
+ActivePTWStore::index_t ActivePTWStore::updates(id_t id) const {
+    return tags(find(id))[m_tag_stride - 1];
+}
+
+
+double ActivePTWStore::logMarginal(id_t id) const {
+    // the log weighted probability of the root
+    return reals(find(id))[2 * m_levels * m_arms + m_levels];
+}
+
+
+void ActivePTWStore::levelPosterior(
+    id_t id,
+    std::vector<double> &out
+) const {
+    levelPosteriorOf(find(id), out);
+}
+
+
+void ActivePTWStore::posteriors(
+    id_t id,
+    size_t level,
+    double *alphas,
+    double *betas
+) const {
+    posteriorsOf(find(id), level, alphas, betas);
+}
+
+
+void ActivePTWStore::levelPosteriorOf(
+    size_t slot,
+    std::vector<double> &out
+) const {
+    const double *log_marginal = reals(slot) + 2 * m_levels * m_arms;
+    const double *log_weighted = log_marginal + m_levels;
+
+    out.resize(m_levels);
+    ActivePTW::computeLevelPosterior(
+        m_depth, LogStopWeight, log_marginal, log_weighted, out.data()
+    );
+}
+
+
+void ActivePTWStore::posteriorsOf(
+    size_t slot,
+    size_t level,
+    double *alphas,
+    double *betas
+) const {
+    size_t cells = m_levels * m_arms;
+    const double *a = reals(slot) + level * m_arms;
+    const double *b = a + cells;
+    const uint64_t *stamps = tags(slot) + level * m_arms;
+    const uint64_t epoch = tags(slot)[cells + level];
+
+    for (size_t i = 0; i < m_arms; i++) {
+        bool fresh = stamps[i] == epoch;
+        alphas[i] = fresh ? a[i] : KT_Alpha;
+        betas[i] = fresh ? b[i] : KT_Alpha;
+    }
+}
+
+
+/* -------------------------------------------------------------------------- */
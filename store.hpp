@@ -0,0 +1,165 @@
+#ifndef __STORE_HPP__
+#define __STORE_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "fastlog.hpp"
+#include "ptw.hpp"
+#include "rng.hpp"
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// a pull of an arm made on behalf of one instance of a store
+struct keyed_pull_t {
+    uint64_t id;
+    size_t arm;
+    int reward;
+};
+
+
+// Many independent ActivePTW instances, such as one per user segment, of the
+// same depth and number of arms, held in a pooled arena.
+//
+// each instance occupies one fixed stride slot of two flat arrays, one of
+// its real valued statistics and one of its epoch tags and time, laid out as
+// in a dense ActivePTW, so an instance costs no heap allocation of its own
+// and its statistics are contiguous. slots are found by instance id, and an
+// evicted instance's slot is reused by the next created. actions are chosen
+// with the generator and scratch space of a worker, shared by every instance
+// it serves.
+//
+// the store is not synchronized: workers may choose actions concurrently,
+// but not while instances are created, evicted or updated.
+class ActivePTWStore {
+
+    public:
+
+        typedef uint64_t id_t;
+        typedef ActivePTW::index_t index_t;
+
+        // the generator and scratch space of one worker
+        struct worker_t {
+            explicit worker_t(const rng_seed_t &seed) : generator(seed) { }
+
+            RandomEngine generator;
+            std::vector<double> posterior;
+            std::vector<double> alphas;
+            std::vector<double> betas;
+        };
+
+        // an empty store of instances over a horizon of 2^depth pulls each,
+        // with log_precision as for ActivePTW
+        ActivePTWStore(size_t depth, size_t arms, double log_precision = 0.0);
+
+        // add an instance at the prior, dying with an error if id exists
+        void create(id_t id);
+
+        // discard an instance, dying with an error if id does not exist
+        void evict(id_t id);
+
+        bool contains(id_t id) const { return m_ids.count(id) != 0; }
+
+        // the number of instances
+        size_t size() const { return m_ids.size(); }
+
+        // the number of slots allocated, live or free
+        size_t capacity() const { return m_slots; }
+
+        // allocate slots for at least n instances
+        void reserve(size_t n);
+
+        // instance id processes arm arm pulled with reward reward
+        void update(id_t id, size_t arm, int reward);
+
+        // process n pulls in order, each by the instance it names
+        void updateBatch(const keyed_pull_t *pulls, size_t n);
+
+        // choose an action for instance id by thompson sampling
+        size_t getAction(id_t id, worker_t &worker) const;
+
+        // the number of updates processed by instance id
+        index_t updates(id_t id) const;
+
+        // the logarithm of the probability of all bits instance id processed
+        double logMarginal(id_t id) const;
+
+        // the posterior probability of each level of instance id
+        void levelPosterior(id_t id, std::vector<double> &out) const;
+
+        // write the beta posterior parameters of every arm at a given level
+        // of instance id into the caller provided arrays, each of size arms
+        void posteriors(
+            id_t id, size_t level,
+            double *alphas, double *betas
+        ) const;
+
+        // the number of bytes of arena per instance
+        size_t stride() const {
+            return m_real_stride * sizeof(double) +
+                m_tag_stride * sizeof(uint64_t);
+        }
+
+    private:
+
+        // the slot of a live instance, dying with an error if there is none
+        size_t find(id_t id) const;
+
+        // process a pull by the instance in a given slot
+        void apply(size_t slot, size_t arm, int reward);
+
+        void levelPosteriorOf(size_t slot, std::vector<double> &out) const;
+        void posteriorsOf(
+            size_t slot, size_t level,
+            double *alphas, double *betas
+        ) const;
+
+        // the start of a slot's real valued statistics: [level][arm] alphas
+        // and betas, then the per level log marginal, log weighted and log
+        // buffer
+        double *reals(size_t slot) { return &m_reals[slot * m_real_stride]; }
+        const double *reals(size_t slot) const {
+            return &m_reals[slot * m_real_stride];
+        }
+
+        // the start of a slot's tags: [level][arm] stamps, per level epochs,
+        // then the number of updates
+        uint64_t *tags(size_t slot) { return &m_tags[slot * m_tag_stride]; }
+        const uint64_t *tags(size_t slot) const {
+            return &m_tags[slot * m_tag_stride];
+        }
+
+        size_t m_depth;
+        size_t m_arms;
+        size_t m_levels;
+
+        // the table driven log arithmetic, or nullptr for the exact path
+        const LogAddTable *m_fast_log;
+
+        // the arena, in slots of m_real_stride reals and m_tag_stride tags
+        size_t m_real_stride;
+        size_t m_tag_stride;
+        size_t m_slots;
+        std::vector<double> m_reals;
+        std::vector<uint64_t> m_tags;
+
+        // the slot of each live instance, and the slots free for reuse
+        std::unordered_map<id_t, size_t> m_ids;
+        std::vector<size_t> m_free;
+
+        // parameters to define the PTW prior, as in ActivePTW
+        double LogSplitWeight;
+        double LogStopWeight;
+
+        static constexpr double KT_Alpha = ActivePTW::KT_Alpha;
+};
+
+
+/* -------------------------------------------------------------------------- */
+
+
+#endif // __STORE_HPP__
@@ -18,35 +18,61 @@
 #include <cassert>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include <algorithm>
+#include <iterator>
 #include <limits>
-#include <random>
 #include <vector>
 
+#include "alias.hpp"
+#include "beta.hpp"
 #include "ptw.hpp"
+#include "snapshot.hpp"
 
 
 /* -------------------------------------------------------------------------- */
 
 
-// generate a sample according to a beta distribution
-double genBetaSample(
-  std::default_random_engine &generator,
-  double alpha,
-  double beta
+// draw a beta sample for each of n arms into samples, which may alias
+// alphas, and return the index of the largest
+static size_t sampleBestArm(
+  RandomEngine &generator,
+  const double *alphas,
+  const double *betas,
+  double *samples,
+  size_t n
 ) {
-  // if X∼Gamma(a, 1), Y∼Gamma(b, 1) then Z = X/(X+Y) ~ Beta(a,b)
-  std::gamma_distribution<double> x_gamma_dist(alpha, 1.0);
-  std::gamma_distribution<double> y_gamma_dist(beta, 1.0);
+  betaSamples(generator, alphas, betas, samples, n);
 
-  double x, y, z;
-  do {
-    x = x_gamma_dist(generator);
-    y = y_gamma_dist(generator);
-    z = x / (x + y);
-  } while (z != z);  // FP trick for avoiding infinities
+  return std::distance(samples, std::max_element(samples, samples + n));
+}
+
+
+// draw a beta sample for each arm, overwriting alphas,
+// and return the index of the largest
+static size_t sampleBestArm(
+  RandomEngine &generator,
+  std::vector<double> &alphas,
+  const std::vector<double> &betas
+) {
+  return sampleBestArm(
+    generator, alphas.data(), betas.data(), alphas.data(), alphas.size()
+  );
+}
 
-  return z;
+
+// gather the arms' posteriors at a given PTW level into the provided
+// buffers, then return the argmax of a beta sample from each
+static size_t sampleBestArm(
+  RandomEngine &generator,
+  const ActivePTW &model,
+  size_t level,
+  std::vector<double> &alphas,
+  std::vector<double> &betas
+) {
+  model.posteriors(level, alphas.data(), betas.data());
+
+  return sampleBestArm(generator, alphas, betas);
 }
 
 
@@ -54,28 +80,43 @@ double genBetaSample(
 
 
 ThompsonSamplingStrategy::ThompsonSamplingStrategy(
-  unsigned int seed, size_t n_arms
+  const rng_seed_t &seed, size_t n_arms
 ) :
   m_generator(seed),
-  m_model(n_arms)
+  m_model(n_arms),
+  m_alphas(n_arms),
+  m_betas(n_arms),
+  m_samples(n_arms)
 {
 }
 
 
-size_t ThompsonSamplingStrategy::getAction() {
-  double best = -std::numeric_limits<double>::infinity();
-  size_t best_idx = 0;
-
+void ThompsonSamplingStrategy::gatherPosteriors() {
   for (size_t i = 0; i < m_model.size(); i++) {
     auto ss = m_model[i].posterior();
-    double r = genBetaSample(m_generator, ss.first, ss.second);
-    if (r > best) {
-      best = r;
-      best_idx = i;
-    }
+    m_alphas[i] = ss.first;
+    m_betas[i] = ss.second;
   }
+}
+
+
+size_t ThompsonSamplingStrategy::getAction() {
+  gatherPosteriors();
+
+  return sampleBestArm(m_generator, m_alphas, m_betas);
+}
+
+
+void ThompsonSamplingStrategy::getActions(size_t n, size_t *out) {
+  gatherPosteriors();
 
-  return best_idx;
+  // the posteriors are unchanged within the batch, so are kept intact
+  for (size_t i = 0; i < n; i++) {
+    out[i] = sampleBestArm(
+      m_generator, m_alphas.data(), m_betas.data(), m_samples.data(),
+      m_samples.size()
+    );
+  }
 }
 
 
@@ -84,15 +125,67 @@ void ThompsonSamplingStrategy::update(size_t arm, int reward) {
 }
 
 
+void ThompsonSamplingStrategy::updateBatch(const pull_t *pulls, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    m_model[pulls[i].arm].update(pulls[i].reward);
+  }
+}
+
+
+/* the estimators are saved as flat arrays of counts and log marginals. */
+void ThompsonSamplingStrategy::save(SnapshotWriter &out) const {
+  size_t n = m_model.size();
+  std::vector<uint64_t> zeros(n), ones(n);
+  std::vector<double> log_kt(n);
+
+  for (size_t i = 0; i < n; i++) {
+    zeros[i] = m_model[i].count(0);
+    ones[i] = m_model[i].count(1);
+    log_kt[i] = m_model[i].logMarginal();
+  }
+
+  out.str(name());
+  out.u64(n);
+  out.rng(m_generator);
+  out.array(zeros);
+  out.array(ones);
+  out.array(log_kt);
+}
+
+
+void ThompsonSamplingStrategy::restore(SnapshotReader &in) {
+  size_t n = m_model.size();
+
+  in.expect(name());
+  in.expect(n, "number of arms");
+  in.rng(m_generator);
+
+  const uint64_t *zeros = in.view<uint64_t>(n);
+  const uint64_t *ones = in.view<uint64_t>(n);
+  const double *log_kt = in.view<double>(n);
+
+  for (size_t i = 0; i < n; i++) {
+    m_model[i].assign(zeros[i], ones[i], log_kt[i]);
+  }
+}
+
+
 /* -------------------------------------------------------------------------- */
 
 
 ActivePTWBanditStrategy::ActivePTWBanditStrategy(
-  unsigned int seed, size_t n_arms
+  const rng_seed_t &seed,
+  size_t n_arms,
+  size_t depth,
+  bool rolling,
+  double log_precision
 ) :
     m_generator(seed),
-    m_model(30, n_arms),
-    m_arms(n_arms)
+    m_model(depth, n_arms, rolling, log_precision),
+    m_arms(n_arms),
+    m_alphas(n_arms),
+    m_betas(n_arms),
+    m_samples(n_arms)
 {
 }
 
@@ -100,21 +193,37 @@ ActivePTWBanditStrategy::ActivePTWBanditStrategy(
 /* sample first a temporal segment according to its posterior weight, then from
    each arms posterior probability, take the argmax as the selected action. */
 size_t ActivePTWBanditStrategy::getAction() {
-  double best = -std::numeric_limits<double>::infinity();
-  size_t best_idx = 0;
-
   size_t level = levelPosteriorSample();
 
-  for (size_t i = 0; i < m_arms; i++) {
-    auto x = m_model.posterior(level, i);
-    double r = genBetaSample(m_generator, x.first, x.second);
-    if (r > best) {
-      best = r;
-      best_idx = i;
+  return sampleBestArm(m_generator, m_model, level, m_alphas, m_betas);
+}
+
+
+/* the model is unchanged within a batch, so each sampled level's posteriors
+   are gathered once and kept, with the samples drawn into separate space. */
+void ActivePTWBanditStrategy::getActions(size_t n, size_t *out) {
+  const AliasTable &sampler = m_model.levelSampler();
+
+  // a rolling model may have grown since the last batch
+  size_t levels = m_model.depth() + 1;
+  m_batch_alphas.resize(levels * m_arms);
+  m_batch_betas.resize(levels * m_arms);
+  m_batch_gathered.assign(levels, false);
+
+  for (size_t i = 0; i < n; i++) {
+    size_t level = sampler.sample(m_generator);
+    double *alphas = &m_batch_alphas[level * m_arms];
+    double *betas = &m_batch_betas[level * m_arms];
+
+    if (!m_batch_gathered[level]) {
+      m_model.posteriors(level, alphas, betas);
+      m_batch_gathered[level] = true;
     }
-  }
 
-  return best_idx;
+    out[i] = sampleBestArm(
+      m_generator, alphas, betas, m_samples.data(), m_arms
+    );
+  }
 }
 
 
@@ -123,15 +232,19 @@ void ActivePTWBanditStrategy::update(size_t arm, int reward) {
 }
 
 
-size_t ActivePTWBanditStrategy::levelPosteriorSample() const {
-  auto lp = m_model.levelPosterior();
-  std::discrete_distribution<size_t> level_dist(lp.begin(), lp.end());
+void ActivePTWBanditStrategy::updateBatch(const pull_t *pulls, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        m_model.update(pulls[i].reward, pulls[i].arm);
+    }
+}
+
 
-  return level_dist(m_generator);
+size_t ActivePTWBanditStrategy::levelPosteriorSample() const {
+  return m_model.levelSampler().sample(m_generator);
 }
 
 
-std::vector<double> ActivePTWBanditStrategy::levelPosterior() const {
+const std::vector<double> &ActivePTWBanditStrategy::levelPosterior() const {
     return m_model.levelPosterior();
 }
 
@@ -141,16 +254,49 @@ const ActivePTW &ActivePTWBanditStrategy::model() const {
 }
 
 
+bool ActivePTWBanditStrategy::ptwProfile(ptw_profile_t &out) const {
+    out.depth = m_model.depth();
+    out.updates = m_model.updates();
+
+    return true;
+}
+
+
+const std::vector<double> *ActivePTWBanditStrategy::ptwLevelPosterior() const {
+    return &m_model.levelPosterior();
+}
+
+
+void ActivePTWBanditStrategy::save(SnapshotWriter &out) const {
+    out.str(name());
+    out.rng(m_generator);
+    m_model.save(out);
+}
+
+
+void ActivePTWBanditStrategy::restore(SnapshotReader &in) {
+    in.expect(name());
+    in.rng(m_generator);
+    m_model.restore(in);
+}
+
+
 /* -------------------------------------------------------------------------- */
 
 
 ParanoidPTWBanditStrategy::ParanoidPTWBanditStrategy(
-  unsigned int seed, size_t n_arms
+  const rng_seed_t &seed,
+  size_t n_arms,
+  size_t depth,
+  bool rolling,
+  double log_precision
 ) :
     m_generator(seed),
     m_arms(n_arms),
-    m_aptw(seed, n_arms),
-    m_trials(0)
+    m_aptw(seed, n_arms, depth, rolling, log_precision),
+    m_trials(0),
+    m_alphas(n_arms),
+    m_betas(n_arms)
 {
 }
 
@@ -163,36 +309,24 @@ size_t ParanoidPTWBanditStrategy::getAction() {
     // after sampling from the posterior over levels,
     // we see whether we need to do forced exploration,
     // and pick the right rate according to the sampled segment size
-    std::uniform_real_distribution<double> uniform01_dist(0.0, 1.0);
-    auto lp = m_aptw.levelPosterior();
+    const auto &lp = m_aptw.levelPosterior();
     size_t k = (lp.size()-1)-level;  // segment size = 2^k
     double clip = std::log(m_trials+1)+1.0;
     while (static_cast<double>(k) > clip) {
         k--;
     }
 
-    if (uniform01_dist(m_generator) < exploreProb(k)) {
+    if (m_generator.uniform() < exploreProb(k)) {
         if (UseUniformExploration) {
-            std::uniform_int_distribution<size_t> randidx(0, m_arms-1);
-            return randidx(m_generator);
+            return static_cast<size_t>(m_generator.below(m_arms));
         } else {
             return leastExploredArm(level);
         }
     }
 
-  double best = -std::numeric_limits<double>::infinity();
-  size_t best_idx = 0;
-
-  for (size_t i = 0; i < m_arms; i++) {
-    auto x = m_aptw.model().posterior(level, i);
-    double r = genBetaSample(m_generator, x.first, x.second);
-    if (r > best) {
-      best = r;
-      best_idx = i;
-    }
-  }
-
-  return best_idx;
+    return sampleBestArm(
+        m_generator, m_aptw.model(), level, m_alphas, m_betas
+    );
 }
 
 
@@ -202,6 +336,22 @@ void ParanoidPTWBanditStrategy::update(size_t arm, int reward) {
 }
 
 
+void ParanoidPTWBanditStrategy::save(SnapshotWriter &out) const {
+    out.str(name());
+    out.rng(m_generator);
+    out.u64(m_trials);
+    m_aptw.save(out);
+}
+
+
+void ParanoidPTWBanditStrategy::restore(SnapshotReader &in) {
+    in.expect(name());
+    in.rng(m_generator);
+    m_trials = static_cast<size_t>(in.u64());
+    m_aptw.restore(in);
+}
+
+
 double ParanoidPTWBanditStrategy::exploreProb(size_t log2_segment_size) const {
     constexpr double C = 1.0;
 
@@ -8,6 +8,7 @@
 
 #include "bandits.hpp"
 #include "ptw.hpp"
+#include "rng.hpp"
 
 
 /* -------------------------------------------------------------------------- */
@@ -17,24 +18,41 @@ class ThompsonSamplingStrategy : public BanditStrategy {
 
     public:
 
-        ThompsonSamplingStrategy(unsigned int seed, size_t n_arms);
+        ThompsonSamplingStrategy(const rng_seed_t &seed, size_t n_arms);
 
         // get the action using a thompson sampling strategy
         size_t getAction() override;
 
+        // gathers the posteriors once for the whole batch
+        void getActions(size_t n, size_t *out) override;
+
         // update the internal PTW environment statistics
         void update(size_t arm, int reward) override;
 
+        void updateBatch(const pull_t *pulls, size_t n) override;
+
         // vanilla Thompson Sampling
         std::string name() const override { return "TS"; }
 
+        void save(SnapshotWriter &out) const override;
+
+        void restore(SnapshotReader &in) override;
+
     private:
 
-        mutable std::default_random_engine m_generator;
+        // gather the per-arm posteriors into the scratch space
+        void gatherPosteriors();
+
+        mutable RandomEngine m_generator;
 
         // models the environment using a Beta distribution
         // that is updated using Bayesian inference
         std::vector<KTEstimator> m_model;
+
+        // scratch space for gathering the per-arm posteriors
+        std::vector<double> m_alphas;
+        std::vector<double> m_betas;
+        std::vector<double> m_samples;
 };
 
 
@@ -45,18 +63,33 @@ class ActivePTWBanditStrategy : public BanditStrategy {
 
     public:
 
-        ActivePTWBanditStrategy(unsigned int seed, size_t n_arms);
+        // PTW over a horizon of 2^depth pulls, optionally extending the
+        // horizon on demand, and optionally using table driven log
+        // arithmetic of the given precision
+        ActivePTWBanditStrategy(
+            const rng_seed_t &seed,
+            size_t n_arms,
+            size_t depth,
+            bool rolling = false,
+            double log_precision = 0.0
+        );
 
         // get the action using a thompson sampling strategy
         size_t getAction() override;
 
+        // computes the level posterior once for the whole batch, and
+        // gathers the arm posteriors of each sampled level only once
+        void getActions(size_t n, size_t *out) override;
+
         // update the internal PTW environment statistics
         void update(size_t arm, int reward) override;
 
+        void updateBatch(const pull_t *pulls, size_t n) override;
+
         std::string name() const override { return "ActivePTW"; }
 
         // the posterior probability of being in a segment of length 2^k
-        std::vector<double> levelPosterior() const;
+        const std::vector<double> &levelPosterior() const;
 
         // sample according to the posterior over segments
         size_t levelPosteriorSample() const;
@@ -64,12 +97,31 @@ class ActivePTWBanditStrategy : public BanditStrategy {
         // PTW statistics accessor
         const ActivePTW &model() const;
 
+        bool ptwProfile(ptw_profile_t &out) const override;
+
+        const std::vector<double> *ptwLevelPosterior() const override;
+
+        void save(SnapshotWriter &out) const override;
+
+        void restore(SnapshotReader &in) override;
+
     private:
 
-        mutable std::default_random_engine m_generator;
+        mutable RandomEngine m_generator;
 
         ActivePTW m_model;
         size_t m_arms;
+
+        // scratch space for gathering the per-arm posteriors
+        std::vector<double> m_alphas;
+        std::vector<double> m_betas;
+
+        // [level][arm] posteriors gathered during a batch of actions,
+        // and which levels have been gathered so far
+        std::vector<double> m_batch_alphas;
+        std::vector<double> m_batch_betas;
+        std::vector<bool> m_batch_gathered;
+        std::vector<double> m_samples;
 };
 
 
@@ -80,7 +132,13 @@ class ParanoidPTWBanditStrategy : public BanditStrategy {
 
     public:
 
-        ParanoidPTWBanditStrategy(unsigned int seed, size_t n_arms);
+        ParanoidPTWBanditStrategy(
+            const rng_seed_t &seed,
+            size_t n_arms,
+            size_t depth,
+            bool rolling = false,
+            double log_precision = 0.0
+        );
 
         size_t getAction() override;
 
@@ -88,6 +146,19 @@ class ParanoidPTWBanditStrategy : public BanditStrategy {
 
         std::string name() const override { return "ParanoidPTW"; }
 
+        bool ptwProfile(ptw_profile_t &out) const override {
+            return m_aptw.ptwProfile(out);
+        }
+
+        const std::vector<double> *ptwLevelPosterior() const override {
+            return m_aptw.ptwLevelPosterior();
+        }
+
+        // the record holds that of the underlying ActivePTW strategy
+        void save(SnapshotWriter &out) const override;
+
+        void restore(SnapshotReader &in) override;
+
     private:
 
         // determine the rate of forced exploration
@@ -98,11 +169,15 @@ class ParanoidPTWBanditStrategy : public BanditStrategy {
         //  the least explored arm
         size_t leastExploredArm(size_t level) const;
 
-        mutable std::default_random_engine m_generator;
+        mutable RandomEngine m_generator;
 
         size_t m_arms;
         ActivePTWBanditStrategy m_aptw;
         size_t m_trials;
+
+        // scratch space for gathering the per-arm posteriors
+        std::vector<double> m_alphas;
+        std::vector<double> m_betas;
 };
 
 
@@ -0,0 +1,83 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ==============================================================================
+
+#include "ts_static.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// the shapes with a compiled specialisation. depths 8 to 20 cover horizons
+// from 256 to roughly a million pulls
+constexpr size_t MinStaticDepth = 8;
+constexpr size_t MaxStaticDepth = 20;
+
+typedef std::index_sequence<2, 3, 5, 7, 10> static_arms_t;
+
+
+// match the depth against each specialised depth for a fixed arm count
+template<size_t Arms, size_t... Offsets>
+static std::unique_ptr<BanditStrategy> createForArms(
+    const rng_seed_t &seed,
+    size_t depth,
+    std::index_sequence<Offsets...>
+) {
+    std::unique_ptr<BanditStrategy> rval;
+
+    ((depth == MinStaticDepth + Offsets ?
+        (rval = std::make_unique<StaticActivePTWBanditStrategy<
+            MinStaticDepth + Offsets, Arms
+        >>(seed), true) : false) || ...);
+
+    return rval;
+}
+
+
+// match the arm count against each specialised arm count
+template<size_t... Arms>
+static std::unique_ptr<BanditStrategy> createForShape(
+    const rng_seed_t &seed,
+    size_t n_arms,
+    size_t depth,
+    std::index_sequence<Arms...>
+) {
+    typedef std::make_index_sequence<
+        MaxStaticDepth - MinStaticDepth + 1
+    > depths_t;
+
+    std::unique_ptr<BanditStrategy> rval;
+
+    ((n_arms == Arms ?
+        (rval = createForArms<Arms>(seed, depth, depths_t()), true) : false)
+        || ...);
+
+    return rval;
+}
+
+
+std::unique_ptr<BanditStrategy> createStaticActivePTWStrategy(
+    const rng_seed_t &seed,
+    size_t n_arms,
+    size_t depth
+) {
+    return createForShape(seed, n_arms, depth, static_arms_t());
+}
+
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,157 @@
+#ifndef __TS_STATIC_HPP__
+#define __TS_STATIC_HPP__
+
+#include <array>
+#include <cstddef>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bandits.hpp"
+#include "beta.hpp"
+#include "ptw_static.hpp"
+#include "rng.hpp"
+#include "snapshot.hpp"
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// the ActivePTW Thompson sampling strategy over a StaticActivePTW model, which
+// makes exactly the same choices as ActivePTWBanditStrategy given the same seed
+template<size_t Depth, size_t Arms>
+class StaticActivePTWBanditStrategy : public BanditStrategy {
+
+    public:
+
+        StaticActivePTWBanditStrategy(const rng_seed_t &seed) :
+            m_generator(seed)
+        {
+        }
+
+        // sample a segment according to its posterior weight, then take the
+        // argmax of a sample from each arms posterior at that level
+        size_t getAction() override {
+            size_t level = m_model.levelSampler().sample(m_generator);
+            m_model.posteriors(level, m_alphas, m_betas);
+
+            return sampleBestArm(m_alphas, m_betas, m_alphas);
+        }
+
+        // the level sampler is refreshed once for the whole batch, and the
+        // posteriors of each sampled level are gathered only once
+        void getActions(size_t n, size_t *out) override {
+            const AliasTable &sampler = m_model.levelSampler();
+            m_batch_gathered.fill(false);
+
+            for (size_t i = 0; i < n; i++) {
+                size_t level = sampler.sample(m_generator);
+
+                if (!m_batch_gathered[level]) {
+                    m_model.posteriors(
+                        level, m_batch_alphas[level], m_batch_betas[level]
+                    );
+                    m_batch_gathered[level] = true;
+                }
+
+                out[i] = sampleBestArm(
+                    m_batch_alphas[level], m_batch_betas[level], m_samples
+                );
+            }
+        }
+
+        void update(size_t arm, int reward) override {
+            m_model.update(reward, arm);
+        }
+
+        void updateBatch(const pull_t *pulls, size_t n) override {
+            for (size_t i = 0; i < n; i++) {
+                m_model.update(pulls[i].reward, pulls[i].arm);
+            }
+        }
+
+        std::string name() const override { return "ActivePTW"; }
+
+        // the record of an ActivePTWBanditStrategy of the same shape, so a
+        // snapshot may be restored into either implementation
+        void save(SnapshotWriter &out) const override {
+            out.str(name());
+            out.rng(m_generator);
+            m_model.save(out);
+        }
+
+        void restore(SnapshotReader &in) override {
+            in.expect(name());
+            in.rng(m_generator);
+            m_model.restore(in);
+        }
+
+        // PTW statistics accessor
+        const StaticActivePTW<Depth, Arms> &model() const { return m_model; }
+
+        bool ptwProfile(ptw_profile_t &out) const override {
+            out.depth = Depth;
+            out.updates = m_model.updates();
+
+            return true;
+        }
+
+        const std::vector<double> *ptwLevelPosterior() const override {
+            return &m_model.levelPosterior();
+        }
+
+    private:
+
+        typedef std::array<double, Arms> arm_values_t;
+
+        // draw a beta sample for each arm into samples, which may alias
+        // alphas, and return the index of the largest
+        size_t sampleBestArm(
+            const arm_values_t &alphas,
+            const arm_values_t &betas,
+            arm_values_t &samples
+        ) {
+            betaSamples(
+                m_generator, alphas.data(), betas.data(), samples.data(), Arms
+            );
+
+            return std::distance(
+                samples.begin(),
+                std::max_element(samples.begin(), samples.end())
+            );
+        }
+
+        RandomEngine m_generator;
+
+        StaticActivePTW<Depth, Arms> m_model;
+
+        // scratch space for gathering the per-arm posteriors
+        arm_values_t m_alphas;
+        arm_values_t m_betas;
+
+        // [level][arm] posteriors gathered during a batch of actions
+        std::array<arm_values_t, Depth + 1> m_batch_alphas;
+        std::array<arm_values_t, Depth + 1> m_batch_betas;
+        std::array<bool, Depth + 1> m_batch_gathered;
+        arm_values_t m_samples;
+};
+
+
+/* -------------------------------------------------------------------------- */
+
+
+// create an ActivePTW strategy specialised for the given depth and number of
+// arms, or nullptr if that shape has no compiled specialisation
+std::unique_ptr<BanditStrategy> createStaticActivePTWStrategy(
+    const rng_seed_t &seed,
+    size_t n_arms,
+    size_t depth
+);
+
+
+/* -------------------------------------------------------------------------- */
+
+
+#endif // __TS_STATIC_HPP__
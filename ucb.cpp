@@ -17,53 +17,83 @@
 
 #include <cmath>
 #include <cstddef>
-#include <limits>
-#include <random>
+#include <algorithm>
 #include <vector>
 
+#include "snapshot.hpp"
+
 
 /* -------------------------------------------------------------------------- */
 
 
-UCBStrategy::UCBStrategy(unsigned int seed, size_t n_arms) :
+UCBStrategy::UCBStrategy(const rng_seed_t &seed, size_t n_arms) :
   m_generator(seed),
   m_arms(n_arms),
   m_arm_cumm_reward(n_arms, 0.0),
   m_arm_visits(n_arms, 0.0),
-  m_visits(0.0)
+  m_visits(0.0),
+  m_unvisited(n_arms, true),
+  m_bounds(n_arms),
+  m_horizon(0.0),
+  m_horizon_log_term(0.0),
+  m_optimism(1.0)
 {
 }
 
 
 void UCBStrategy::reset() {
   m_visits = 0.0;
-  m_arm_cumm_reward = std::vector<double>(m_arms, 0.0);
-  m_arm_visits = std::vector<double>(m_arms, 0.0);
+  m_arm_cumm_reward.assign(m_arms, 0.0);
+  m_arm_visits.assign(m_arms, 0.0);
+  m_unvisited.reset(m_arms, true);
+  m_bounds.resize(m_arms);
+  m_horizon = 0.0;
+  m_optimism = 1.0;
 }
 
 
 size_t UCBStrategy::getAction() {
-  auto unvisited = unvisitedArms();
-
   // if we have any unvisited arms, pick one uniformly at random
-  if (!unvisited.empty()) {
-    std::uniform_int_distribution<size_t> randidx(0, unvisited.size()-1);
-    return unvisited[randidx(m_generator)];
+  if (!m_unvisited.empty()) {
+    m_optimism = 1.0;
+    return m_unvisited.select(m_generator.below(m_unvisited.size()));
   }
 
   // ...otherwise pick the arm with the maximising UCB score
-  double best = -std::numeric_limits<double>::infinity();
-  size_t best_idx = 0;
+  return bestArm();
+}
 
-  for (size_t i = 0; i < m_arms; i++) {
-    double score = ucb(i);
-    if (score > best) {
-      best = score;
-      best_idx = i;
+
+void UCBStrategy::getActions(size_t n, size_t *out) {
+  if (!m_unvisited.empty()) {
+    for (size_t i = 0; i < n; i++) {
+      out[i] = m_unvisited.select(m_generator.below(m_unvisited.size()));
     }
+    m_optimism = 1.0;
+    return;
   }
 
-  return best_idx;
+  std::fill(out, out + n, bestArm());
+}
+
+
+size_t UCBStrategy::bestArm() {
+  if (m_visits > m_horizon) rebuildBounds();
+
+  double log_term = 2.0 * std::log(m_visits);
+
+  size_t arm = m_bounds.argmax([&](size_t i) { return ucb(i, log_term); });
+  m_optimism = std::min(1.0, ucb(arm, log_term));
+
+  return arm;
+}
+
+
+void UCBStrategy::rebuildBounds() {
+  m_horizon = boundHorizon(m_visits);
+  m_horizon_log_term = 2.0 * std::log(m_horizon);
+
+  m_bounds.rebuild([&](size_t i) { return ucb(i, m_horizon_log_term); });
 }
 
 
@@ -71,29 +101,69 @@ void UCBStrategy::update(size_t arm, int reward) {
     m_arm_cumm_reward[arm] += reward;
     m_arm_visits[arm] += 1.0;
     m_visits += 1.0;
+
+    // bounds past their horizon are rebuilt before the next use
+    m_unvisited.erase(arm);
+
+    double bound = UpperBoundTree::Infinity;
+    if (m_visits <= m_horizon) bound = ucb(arm, m_horizon_log_term);
+
+    m_bounds.set(arm, {m_arm_cumm_reward[arm], m_arm_visits[arm]}, bound);
 }
 
 
-std::vector<size_t> UCBStrategy::unvisitedArms() const {
-  std::vector<size_t> rval;
+void UCBStrategy::updateBatch(const pull_t *pulls, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        UCBStrategy::update(pulls[i].arm, pulls[i].reward);
+    }
+}
 
-  for (size_t arm=0; arm < m_arms; arm++) {
-    if (m_arm_visits[arm] == 0.0)
-      rval.emplace_back(arm);
-  }
 
-  return rval;
+void UCBStrategy::save(SnapshotWriter &out) const {
+  out.str(name());
+  out.u64(m_arms);
+  out.rng(m_generator);
+  out.array(m_arm_cumm_reward);
+  out.array(m_arm_visits);
+  out.f64(m_visits);
+  out.f64(m_horizon);
+  out.f64(m_horizon_log_term);
+  out.f64(m_optimism);
+
+  std::vector<double> bounds(m_arms);
+  for (size_t i = 0; i < m_arms; i++) bounds[i] = m_bounds.bound(i);
+  out.array(bounds);
 }
 
 
-double UCBStrategy::ucb(size_t arm) const {
+void UCBStrategy::restore(SnapshotReader &in) {
+  in.expect(name());
+  in.expect(m_arms, "number of arms");
+  in.rng(m_generator);
+  in.array(m_arm_cumm_reward.data(), m_arms);
+  in.array(m_arm_visits.data(), m_arms);
+  m_visits = in.f64();
+  m_horizon = in.f64();
+  m_horizon_log_term = in.f64();
+  m_optimism = in.f64();
+
+  const double *bounds = in.view<double>(m_arms);
+
+  m_unvisited.reset(m_arms, false);
+  m_bounds.resize(m_arms);
+  for (size_t i = 0; i < m_arms; i++) {
+    if (m_arm_visits[i] == 0.0) m_unvisited.insert(i);
+    m_bounds.set(i, {m_arm_cumm_reward[i], m_arm_visits[i]}, bounds[i]);
+  }
+}
+
+
+double UCBStrategy::ucb(size_t arm, double log_term) const {
   double mean = m_arm_cumm_reward[arm] / m_arm_visits[arm];
-  double ci   = std::sqrt((2.0 * std::log(m_visits)) / m_arm_visits[arm]);
+  double ci   = std::sqrt(log_term / m_arm_visits[arm]);
 
   return mean + ci;
 }
 
 
 /* -------------------------------------------------------------------------- */
-
-
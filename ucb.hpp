@@ -7,6 +7,8 @@
 #include <vector>
 
 #include "bandits.hpp"
+#include "index.hpp"
+#include "rng.hpp"
 
 
 /* -------------------------------------------------------------------------- */
@@ -16,36 +18,65 @@ class UCBStrategy : public BanditStrategy {
 
     public:
 
-        UCBStrategy(unsigned int seed, size_t n_arms);
+        UCBStrategy(const rng_seed_t &seed, size_t n_arms);
 
         // implement a UCB policy
         size_t getAction() override;
 
+        // the scores are unchanged within a batch, so are computed once
+        void getActions(size_t n, size_t *out) override;
+
         // update the internal algorithm statistics
         void update(size_t arm, int reward) override;
 
+        void updateBatch(const pull_t *pulls, size_t n) override;
+
         std::string name() const override { return "UCB"; }
 
+        void save(SnapshotWriter &out) const override;
+
+        // restores the bounds as they were, so the search is unchanged
+        void restore(SnapshotReader &in) override;
+
         // resets the mean/visit statistics
         void reset();
 
+        // the UCB score of the last action, clipped to at most 1, which is
+        // an optimistic estimate of the best arm's mean
+        double optimism() const { return m_optimism; }
+
     private:
 
-        // gives a vector of unvisited arms
-        std::vector<size_t> unvisitedArms() const;
+        // UCB score of a given arm, where log_term is twice the log
+        // of the time at which it is evaluated
+        double ucb(size_t arm, double log_term) const;
 
-        // UCB score of a given arm
-        double ucb(size_t arm) const;
+        // the arm with the maximising UCB score
+        size_t bestArm();
+
+        // bound every arm's score until a new horizon
+        void rebuildBounds();
 
         // limited amount of randomness used in this implementation
         // so that the "play each arm once" step is done according
         // to a random permutation of the arm indices
-        mutable std::default_random_engine m_generator;
+        mutable RandomEngine m_generator;
 
         size_t m_arms;
         std::vector<double> m_arm_cumm_reward;
         std::vector<double> m_arm_visits;
         double m_visits;
+
+        // the arms not yet visited
+        RankSet m_unvisited;
+
+        // each arm's score at the horizon, which bounds its score at every
+        // earlier time, since the exploration bonus grows with time
+        UpperBoundTree m_bounds;
+        double m_horizon;
+        double m_horizon_log_term;
+
+        double m_optimism;
 };
 
 
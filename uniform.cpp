@@ -17,14 +17,15 @@
 
 #include <cassert>
 #include <cstddef>
-#include <random>
+
+#include "snapshot.hpp"
 
 
 /* -------------------------------------------------------------------------- */
 
 
 UniformSamplingStrategy::UniformSamplingStrategy(
-    unsigned int seed,
+    const rng_seed_t &seed,
     size_t n_arms
 ) :
     m_generator(seed),
@@ -35,9 +36,21 @@ UniformSamplingStrategy::UniformSamplingStrategy(
 
 
 size_t UniformSamplingStrategy::getAction() {
-    std::uniform_int_distribution<size_t> randidx(0, m_arms-1);
+    return static_cast<size_t>(m_generator.below(m_arms));
+}
+
+
+void UniformSamplingStrategy::save(SnapshotWriter &out) const {
+    out.str(name());
+    out.u64(m_arms);
+    out.rng(m_generator);
+}
+
 
-    return randidx(m_generator);
+void UniformSamplingStrategy::restore(SnapshotReader &in) {
+    in.expect(name());
+    in.expect(m_arms, "number of arms");
+    in.rng(m_generator);
 }
 
 
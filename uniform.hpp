@@ -6,6 +6,7 @@
 #include <random>
 
 #include "bandits.hpp"
+#include "rng.hpp"
 
 
 /* -------------------------------------------------------------------------- */
@@ -15,7 +16,7 @@ class UniformSamplingStrategy : public BanditStrategy {
 
     public:
 
-        UniformSamplingStrategy(unsigned int seed, size_t n_arms);
+        UniformSamplingStrategy(const rng_seed_t &seed, size_t n_arms);
 
         // pick an action uniformly at random
         size_t getAction() override;
@@ -25,9 +26,13 @@ class UniformSamplingStrategy : public BanditStrategy {
 
         std::string name() const override { return "Uniform"; };
 
+        void save(SnapshotWriter &out) const override;
+
+        void restore(SnapshotReader &in) override;
+
     private:
 
-        mutable std::default_random_engine m_generator;
+        mutable RandomEngine m_generator;
         size_t m_arms;
 };
 